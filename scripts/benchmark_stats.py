@@ -0,0 +1,351 @@
+#!/usr/bin/env python3
+"""Runs graph_compute configurations repeatedly and summarizes them as JSON.
+
+Every configuration is a set of make variables (e.g. "D1_CHUNK=1
+CHUNK_BITS=16 PARALLEL=1").  It is built with the top-level Makefile and
+then run --warmup times without recording anything, then --runs times.
+The compact comma-separated line printed by compute is parsed after each
+run.  Each configuration then reports the median, minimum, and a
+distribution-free confidence interval of the median for time per million
+edges and seconds.  It also reports the median peak RSS and, for
+PERF_COUNTERS=1 builds, the median hardware counter totals.
+
+A configuration whose coefficient of variation of time per million edges
+exceeds --max-cv is measured again (up to --attempts times).  If it is
+still too noisy, it is reported with status "unstable" and without
+summary numbers, and the script exits with a non-zero status.
+
+Example:
+  scripts/benchmark_stats.py --runs 10 --config "BASELINE=1 PARALLEL=1" \\
+    --config "D1_CHUNK=1 CHUNK_BITS=16 PARALLEL=1" --output results.json \\
+    10 input_data/graph.adjlist input_data/graph.node
+"""
+
+import argparse
+import datetime
+import json
+import math
+import os
+import platform
+import shlex
+import subprocess
+import sys
+import tempfile
+
+SCHEMA_VERSION = 1
+
+# The fields of printCompactOutput in src/graph_compute/compute.cpp, in order
+COMPACT_FIELDS = [
+    'app', 'scheduler', 'in_place', 'convergence', 'parallel', 'workers',
+    'seconds', 'time_per_million_edges', 'sizeof_vertex', 'sizeof_sched',
+    'sizeof_data', 'hash', 'rounds', 'edge_file', 'nodes', 'edges',
+    'chunk_bits', 'numa_init', 'numa_steal', 'distance', 'build_date',
+    'build_time', 'startup_load', 'startup_check_graph',
+    'startup_init_scheduling', 'startup_fill_in_node_data',
+    'startup_fill_in_global_data', 'break_even_rounds', 'tracked_bytes',
+    'peak_rss_kib',
+]
+
+INTEGER_FIELDS = set([
+    'in_place', 'parallel', 'workers', 'sizeof_vertex', 'sizeof_sched',
+    'sizeof_data', 'rounds', 'nodes', 'edges', 'chunk_bits', 'numa_init',
+    'numa_steal', 'distance', 'tracked_bytes', 'peak_rss_kib',
+])
+
+FLOAT_FIELDS = set([
+    'convergence', 'seconds', 'time_per_million_edges', 'startup_load',
+    'startup_check_graph', 'startup_init_scheduling',
+    'startup_fill_in_node_data', 'startup_fill_in_global_data',
+    'break_even_rounds',
+])
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('rounds', type=int, help='rounds per run')
+    parser.add_argument('edge_file', help='adjacency graph to run on')
+    parser.add_argument('node_file', nargs='?', help='node file (MASS_SPRING_DASHPOT)')
+    parser.add_argument('--config', action='append', default=[],
+                        help='make variables of one configuration; may be repeated. '
+                             'Without any, the existing compute binary is run as is.')
+    parser.add_argument('--runs', type=int, default=10, help='measured runs')
+    parser.add_argument('--warmup', type=int, default=2, help='unrecorded runs first')
+    parser.add_argument('--max-cv', type=float, default=0.05,
+                        help='largest coefficient of variation of time per million '
+                             'edges that is still reported')
+    parser.add_argument('--attempts', type=int, default=2,
+                        help='times a configuration is measured before it is '
+                             'given up as unstable')
+    parser.add_argument('--confidence', type=float, default=0.95,
+                        help='confidence level of the interval around the median')
+    parser.add_argument('--env', action='append', default=[],
+                        help='KEY=VALUE added to the environment of compute, '
+                             'e.g. CILK_NWORKERS=8; may be repeated')
+    parser.add_argument('--root', default=os.path.join(os.path.dirname(
+                            os.path.abspath(__file__)), os.pardir),
+                        help='repository root (default: the parent of scripts/)')
+    parser.add_argument('--output', help='JSON file to write (default: stdout)')
+    args = parser.parse_args()
+
+    if args.runs < 2:
+        parser.error('--runs needs to be at least 2 to estimate the variance')
+
+    env = dict(os.environ)
+    for assignment in args.env:
+        key, _, value = assignment.partition('=')
+        env[key] = value
+
+    root = os.path.abspath(args.root)
+    compute = os.path.join(root, 'src', 'graph_compute', 'compute')
+    command = [compute, str(args.rounds), args.edge_file]
+    if args.node_file:
+        command.append(args.node_file)
+
+    results = []
+    for config in (args.config or [None]):
+        if config is not None:
+            build(root, config)
+        results.append(benchmark(config, command, env, args))
+
+    document = {
+        'schema_version': SCHEMA_VERSION,
+        'created': datetime.datetime.now().isoformat(),
+        'host': {
+            'hostname': platform.node(),
+            'machine': platform.machine(),
+            'cpus': os.cpu_count(),
+        },
+        'settings': {
+            'rounds': args.rounds,
+            'edge_file': args.edge_file,
+            'node_file': args.node_file,
+            'runs': args.runs,
+            'warmup': args.warmup,
+            'max_cv': args.max_cv,
+            'attempts': args.attempts,
+            'confidence': args.confidence,
+            'env': args.env,
+        },
+        'results': results,
+    }
+    text = json.dumps(document, indent=2, sort_keys=True)
+    if args.output:
+        with open(args.output, 'w') as out:
+            out.write(text + '\n')
+    else:
+        print(text)
+
+    if any(result['status'] != 'ok' for result in results):
+        sys.exit(1)
+
+
+def build(root, config, make='make'):
+    """Rebuilds compute with the make variables in config"""
+    variables = shlex.split(config)
+    log('building: ' + config)
+    subprocess.check_call([make, 'clean-graph-compute'], cwd=root,
+                          stdout=subprocess.DEVNULL)
+    subprocess.check_call([make] + variables + ['build-graph-compute'], cwd=root,
+                          stdout=subprocess.DEVNULL)
+
+
+def run_once(command, env):
+    """Runs compute once; returns its compact output fields, its perf
+    counter totals (None unless built with PERF_COUNTERS=1) and its peak
+    resident set size in KiB"""
+    with tempfile.TemporaryFile(mode='w+') as stdout, \
+            tempfile.TemporaryFile(mode='w+') as stderr:
+        process = subprocess.Popen(command, env=env, stdout=stdout, stderr=stderr)
+        # wait4 rather than wait, for the resource usage of this child alone
+        _, status, usage = os.wait4(process.pid, 0)
+        process.returncode = status  # already reaped; keeps Popen from waiting
+        stdout.seek(0)
+        stderr.seek(0)
+        if not os.WIFEXITED(status) or os.WEXITSTATUS(status) != 0:
+            raise RuntimeError('%s failed (status %d):\n%s' % (
+                ' '.join(command), status, stderr.read()))
+        fields, counters = parse_output(stdout.read())
+    return fields, counters, usage.ru_maxrss
+
+
+def parse_output(stdout):
+    """Returns the fields of the compact output line, and the PERF totals
+    summed over all batches"""
+    fields = None
+    counters = None
+    counter_names = None
+    for line in stdout.splitlines():
+        columns = [column.strip() for column in line.split(',')]
+        if columns[0] == 'PERF':
+            if columns[2] == 'worker':
+                counter_names = columns[5:]
+            elif columns[2] == 'total' and counter_names:
+                if counters is None:
+                    counters = dict((name, 0) for name in counter_names)
+                for name, value in zip(counter_names, columns[5:]):
+                    # -1 means the CPU could not count this event
+                    if counters[name] is not None:
+                        counters[name] = None if int(value) < 0 \
+                            else counters[name] + int(value)
+        elif len(columns) == len(COMPACT_FIELDS):
+            fields = dict(zip(COMPACT_FIELDS, columns))
+    if fields is None:
+        raise RuntimeError('no compact output line (was compute built with '
+                           'VERBOSE=1?):\n' + stdout)
+    for name in INTEGER_FIELDS:
+        fields[name] = int(fields[name])
+    for name in FLOAT_FIELDS:
+        fields[name] = float(fields[name])
+    return fields, counters
+
+
+def median(values):
+    ordered = sorted(values)
+    middle = len(ordered) // 2
+    if len(ordered) % 2:
+        return ordered[middle]
+    return (ordered[middle - 1] + ordered[middle]) / 2.0
+
+
+def median_interval(values, confidence):
+    """A distribution-free confidence interval of the median: the order
+    statistics (j, k) with P(X_(j) <= median <= X_(k)) >= confidence under
+    the binomial(n, 1/2) distribution of the number of samples below the
+    median.  Falls back to (min, max) when n is too small to reach the
+    requested confidence."""
+    ordered = sorted(values)
+    n = len(ordered)
+    cdf = []
+    total = 0.0
+    for i in range(n + 1):
+        total += math.exp(math.lgamma(n + 1) - math.lgamma(i + 1)
+                          - math.lgamma(n - i + 1) - n * math.log(2.0))
+        cdf.append(total)
+    # widen symmetrically from the middle until the coverage is reached
+    for j in range(n // 2, -1, -1):
+        k = n - 1 - j
+        if j > k:
+            continue
+        # [X_(j), X_(k)] (0-based) covers the median unless fewer than j + 1
+        # or more than k samples lie below it
+        if cdf[k] - cdf[j] >= confidence:
+            return ordered[j], ordered[k], True
+    return ordered[0], ordered[-1], False
+
+
+def summarize(values, confidence):
+    mean = sum(values) / len(values)
+    variance = sum((value - mean) ** 2 for value in values) / (len(values) - 1)
+    low, high, reached = median_interval(values, confidence)
+    return {
+        'median': median(values),
+        'min': min(values),
+        'max': max(values),
+        'mean': mean,
+        'stdev': math.sqrt(variance),
+        'cv': math.sqrt(variance) / mean if mean > 0 else None,
+        'ci_low': low,
+        'ci_high': high,
+        'ci_confidence_reached': reached,
+    }
+
+
+def benchmark(config, command, env, args):
+    """Measures one configuration; returns its entry of "results" """
+    status = 'failed'
+    samples = []
+    error = None
+    cv = None
+    for attempt in range(1, args.attempts + 1):
+        log('%s: attempt %d, %d warmup and %d measured runs' % (
+            config or 'existing build', attempt, args.warmup, args.runs))
+        try:
+            for _ in range(args.warmup):
+                run_once(command, env)
+            samples = [run_once(command, env) for _ in range(args.runs)]
+        except RuntimeError as failure:
+            error = str(failure)
+            log(error)
+            break
+        times = [fields['time_per_million_edges'] for fields, _, _ in samples]
+        cv = summarize(times, args.confidence)['cv']
+        if cv is not None and cv <= args.max_cv:
+            status = 'ok'
+            break
+        status = 'unstable'
+        log('coefficient of variation %.4f is above %.4f' % (cv or 0.0, args.max_cv))
+
+    result = {
+        'config': config,
+        'status': status,
+        'attempts': attempt,
+        'error': error,
+        'cv': cv,
+        'samples': [{
+            'seconds': fields['seconds'],
+            'time_per_million_edges': fields['time_per_million_edges'],
+            'max_rss_kib': rss,
+            'hash': fields['hash'],
+            'counters': counters,
+        } for fields, counters, rss in samples],
+    }
+    if not samples:
+        return result
+
+    first = samples[0][0]
+    result.update({
+        'app': first['app'],
+        'scheduler': first['scheduler'],
+        'parallel': first['parallel'],
+        'in_place': first['in_place'],
+        'workers': first['workers'],
+        'rounds': first['rounds'],
+        'chunk_bits': first['chunk_bits'],
+        'distance': first['distance'],
+        'graph': {
+            'edge_file': first['edge_file'],
+            'nodes': first['nodes'],
+            'edges': first['edges'],
+        },
+        'sizeof': {
+            'vertex': first['sizeof_vertex'],
+            'sched': first['sizeof_sched'],
+            'data': first['sizeof_data'],
+        },
+        # several hashes mean the schedule changed the results
+        'hashes': sorted(set(fields['hash'] for fields, _, _ in samples)),
+    })
+    if status != 'ok':
+        # refuse to summarize noisy numbers; the raw samples are kept above
+        return result
+
+    result['time_per_million_edges'] = summarize(
+        [fields['time_per_million_edges'] for fields, _, _ in samples], args.confidence)
+    result['seconds'] = summarize(
+        [fields['seconds'] for fields, _, _ in samples], args.confidence)
+    result['startup_seconds'] = median(
+        [sum(fields[name] for name in COMPACT_FIELDS if name.startswith('startup_'))
+         for fields, _, _ in samples])
+    result['memory'] = {
+        'max_rss_kib': median([rss for _, _, rss in samples]),
+        'tracked_bytes': first['tracked_bytes'],
+        'tracked_bytes_per_edge': first['tracked_bytes'] / max(first['edges'], 1),
+    }
+    if samples[0][1] is None:
+        result['counters'] = None
+    else:
+        result['counters'] = dict(
+            (name, None if any(counters[name] is None for _, counters, _ in samples)
+             else median([counters[name] for _, counters, _ in samples]))
+            for name in samples[0][1])
+    return result
+
+
+def log(message):
+    sys.stderr.write(message + '\n')
+    sys.stderr.flush()
+
+
+if __name__ == '__main__':
+    main()
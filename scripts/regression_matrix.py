@@ -0,0 +1,216 @@
+#!/usr/bin/env python3
+"""Runs every valid combination of app, scheduler, DISTANCE and PARALLEL
+on a small reference graph, and checks the results against serial D0_BSP.
+
+Each combination is built with the top-level Makefile and run --runs
+times.  Its compact output lines are checked in three ways:
+
+  bitwise      The result hash must equal the serial D0_BSP hash.  This
+               applies with DISTANCE=0 (every vertex reads the previous
+               round's data) to schedulers that keep each vertex's edge
+               order, so the floating point sums come out the same.
+  determinism  Every run must give the same hash, and a parallel run must
+               reproduce the hash of the serial run of the same scheduler.
+               This applies to DISTANCE=0, and to schedulers whose
+               dependencies fix the order of updates (all but D1_LOCKS).
+  tolerance    The convergence measure must be within --jacobi-tolerance
+               of D0_BSP with DISTANCE=0.  With DISTANCE > 0, asynchronous
+               schedulers converge faster than BSP, so they may only be
+               worse by --async-tolerance.
+
+With --baseline, the median time per million edges of every combination
+is compared with the stored one, and anything slower by more than
+--perf-tolerance is flagged.  --write-baseline stores the current times.
+
+Exits with a non-zero status if any check fails.
+
+Example:
+  scripts/regression_matrix.py --node-file graph.node --baseline base.json \\
+    10 graph.adjlist
+"""
+
+import argparse
+import copy
+import json
+import os
+import subprocess
+import sys
+
+from benchmark_stats import build, log, median, run_once
+
+APPS = ['PAGERANK', 'MASS_SPRING_DASHPOT']
+
+# scheduler: (valid DISTANCEs, keeps edge order, deterministic with DISTANCE > 0)
+SCHEDULERS = [
+    ('D0_BSP', [0], True, True),
+    ('BASELINE', [0, 1], False, True),
+    ('D1_PRIO', [0, 1], False, True),
+    ('D1_CHROM', [0, 1], True, True),
+    ('D1_LOCKS', [0, 1], False, False),
+    ('D1_CHUNK', [0, 1], False, True),
+    ('D1_PHASE', [0, 1, 2], True, True),
+    ('D1_NUMA', [0, 1, 2], True, True),
+]
+
+
+def main():
+    parser = argparse.ArgumentParser(
+        description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    parser.add_argument('rounds', type=int, help='rounds per run')
+    parser.add_argument('edge_file', help='small reference graph')
+    parser.add_argument('--node-file', help='node file; MASS_SPRING_DASHPOT is '
+                                            'skipped without one')
+    parser.add_argument('--apps', default=','.join(APPS),
+                        help='comma-separated apps (default: %(default)s)')
+    parser.add_argument('--schedulers', default=','.join(s[0] for s in SCHEDULERS),
+                        help='comma-separated schedulers (default: all)')
+    parser.add_argument('--serial-only', action='store_true',
+                        help='skip the PARALLEL=1 builds')
+    parser.add_argument('--chunk-bits', type=int, default=6,
+                        help='CHUNK_BITS, small enough for several chunks')
+    parser.add_argument('--numa-workers', type=int, default=4)
+    parser.add_argument('--runs', type=int, default=3,
+                        help='timed runs per combination')
+    parser.add_argument('--jacobi-tolerance', type=float, default=1e-6)
+    parser.add_argument('--async-tolerance', type=float, default=0.05)
+    parser.add_argument('--baseline', help='JSON file of stored times to compare with')
+    parser.add_argument('--write-baseline', help='JSON file to store the times in')
+    parser.add_argument('--perf-tolerance', type=float, default=0.10,
+                        help='allowed slowdown against --baseline')
+    parser.add_argument('--make', default='make', help='make command')
+    parser.add_argument('--root', default=os.path.join(os.path.dirname(
+                            os.path.abspath(__file__)), os.pardir),
+                        help='repository root (default: the parent of scripts/)')
+    parser.add_argument('--output', help='JSON file for all results')
+    args = parser.parse_args()
+
+    root = os.path.abspath(args.root)
+    compute = os.path.join(root, 'src', 'graph_compute', 'compute')
+    baseline = {}
+    if args.baseline:
+        with open(args.baseline) as inp:
+            baseline = json.load(inp)
+
+    schedulers = [s for s in SCHEDULERS if s[0] in args.schedulers.split(',')]
+    results = []
+    for app in args.apps.split(','):
+        command = [compute, str(args.rounds), args.edge_file]
+        if app == 'MASS_SPRING_DASHPOT':
+            if not args.node_file:
+                log('skipping MASS_SPRING_DASHPOT: no --node-file')
+                continue
+            command.append(args.node_file)
+        reference = run_combination(args, root, command, app, 'D0_BSP', 0, 0)
+        for scheduler, distances, keeps_edge_order, deterministic in schedulers:
+            for distance in distances:
+                serial = None
+                for parallel in ([0] if args.serial_only else [0, 1]):
+                    if (scheduler, distance, parallel) == ('D0_BSP', 0, 0):
+                        result = copy.deepcopy(reference)
+                    else:
+                        result = run_combination(args, root, command, app, scheduler,
+                                                 distance, parallel)
+                    if parallel == 0:
+                        serial = result
+                    check(args, result, reference, serial, keeps_edge_order,
+                          deterministic, baseline)
+                    results.append(result)
+                    print_result(result)
+
+    if args.write_baseline:
+        with open(args.write_baseline, 'w') as out:
+            json.dump(dict((r['key'], r['time_per_million_edges']) for r in results
+                           if r['time_per_million_edges'] is not None),
+                      out, indent=2, sort_keys=True)
+            out.write('\n')
+    if args.output:
+        with open(args.output, 'w') as out:
+            json.dump(results, out, indent=2, sort_keys=True)
+            out.write('\n')
+
+    failures = [r for r in results if r['failures']]
+    print('%d combinations, %d failed' % (len(results), len(failures)))
+    if failures:
+        sys.exit(1)
+
+
+def run_combination(args, root, command, app, scheduler, distance, parallel):
+    config = '%s=1 %s=1 DISTANCE=%d PARALLEL=%d CHUNK_BITS=%d' % (
+        app, scheduler, distance, parallel, args.chunk_bits)
+    if scheduler == 'D1_NUMA':
+        config += ' NUMA_WORKERS=%d' % (args.numa_workers if parallel else 1)
+    result = {
+        'key': '%s/%s/DISTANCE=%d/PARALLEL=%d' % (app, scheduler, distance, parallel),
+        'config': config,
+        'hash': None,
+        'hashes': [],
+        'convergence': None,
+        'time_per_million_edges': None,
+        'checks': [],
+        'failures': [],
+    }
+    try:
+        build(root, config, args.make)
+        samples = [run_once(command, os.environ)[0] for _ in range(args.runs)]
+    except (RuntimeError, OSError, subprocess.CalledProcessError) as error:
+        result['failures'].append('did not run: %s' % error)
+        return result
+    result['hashes'] = sorted(set(fields['hash'] for fields in samples))
+    result['hash'] = samples[0]['hash']
+    result['convergence'] = samples[0]['convergence']
+    result['time_per_million_edges'] = median(
+        [fields['time_per_million_edges'] for fields in samples])
+    return result
+
+
+def check(args, result, reference, serial, keeps_edge_order, deterministic, baseline):
+    if result['hash'] is None or reference['hash'] is None:
+        return
+    distance = int(result['key'].split('DISTANCE=')[1].split('/')[0])
+    parallel = result['key'].endswith('PARALLEL=1')
+
+    if distance == 0 and keeps_edge_order:
+        result['checks'].append('bitwise')
+        if result['hash'] != reference['hash']:
+            result['failures'].append('hash %s differs from D0_BSP %s' % (
+                result['hash'], reference['hash']))
+    if distance == 0 or deterministic:
+        result['checks'].append('determinism')
+        if len(result['hashes']) > 1:
+            result['failures'].append('hash changed between runs: %s' % result['hashes'])
+        if parallel and serial is not None and serial['hash'] is not None \
+                and result['hash'] != serial['hash']:
+            result['failures'].append('hash %s differs from the serial run %s' % (
+                result['hash'], serial['hash']))
+
+    result['checks'].append('tolerance')
+    expected = reference['convergence']
+    if distance == 0:
+        allowed = args.jacobi_tolerance * abs(expected)
+        if abs(result['convergence'] - expected) > allowed:
+            result['failures'].append('convergence %g is not within %g of D0_BSP %g' % (
+                result['convergence'], args.jacobi_tolerance, expected))
+    elif result['convergence'] > expected * (1.0 + args.async_tolerance):
+        result['failures'].append('convergence %g is worse than D0_BSP %g' % (
+            result['convergence'], expected))
+
+    stored = baseline.get(result['key'])
+    if stored is not None:
+        result['checks'].append('performance')
+        result['baseline_time_per_million_edges'] = stored
+        if result['time_per_million_edges'] > stored * (1.0 + args.perf_tolerance):
+            result['failures'].append('%.6g s per million edges, baseline %.6g' % (
+                result['time_per_million_edges'], stored))
+
+
+def print_result(result):
+    status = 'FAIL' if result['failures'] else 'ok'
+    print('%-4s %-50s %-24s %s' % (status, result['key'], result['hash'],
+                                   ','.join(result['checks'])))
+    for failure in result['failures']:
+        print('       ' + failure)
+    sys.stdout.flush()
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,200 @@
+#ifndef ACCESS_STREAM_H_
+#define ACCESS_STREAM_H_
+
+#include <cstdint>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include "./common.h"
+#include "./cache_model.h"
+#include "../graph_compute/phase_boundaries.h"
+
+using namespace std;
+
+//  The graph in compressed sparse row form, as compute lays it out
+struct graph_t {
+  vid_t cntNodes;
+  vid_t cntEdges;
+  vector<vid_t> offsets;  //  cntNodes + 1 entries
+  vector<vid_t> edges;
+};
+typedef struct graph_t graph_t;
+
+//  The vertex updates each worker does between two barriers
+typedef vector<vector<vid_t> > stage_t;
+
+//  A scheduler's whole round: stages run one after the other
+typedef vector<stage_t> schedule_t;
+
+//  Splits order into cntWorkers contiguous blocks, like a cilk_for would
+static inline stage_t splitAmongWorkers(const vector<vid_t>& order,
+                                        const int cntWorkers) {
+  stage_t stage(cntWorkers);
+  const uint64_t size = order.size();
+  for (int w = 0; w < cntWorkers; w++) {
+    stage[w].assign(order.begin() + size * w / cntWorkers,
+                    order.begin() + size * (w + 1) / cntWorkers);
+  }
+  return stage;
+}
+
+//  D0_BSP: every vertex in order
+static inline schedule_t bspSchedule(const graph_t& graph, const int cntWorkers) {
+  vector<vid_t> order(graph.cntNodes);
+  for (vid_t v = 0; v < graph.cntNodes; v++) {
+    order[v] = v;
+  }
+  return schedule_t(1, splitAmongWorkers(order, cntWorkers));
+}
+
+//  D1_CHUNK and D1_NUMA with one phase: each worker runs its own
+//  contiguous range of chunks, vertices in order within a chunk.
+//  D1_PHASE and D1_NUMA: each worker runs the first phase of all its
+//  chunks, then, after a barrier, the next one, and so on.  The phase
+//  boundaries are those createPhaseBoundaries picks.
+static inline schedule_t chunkSchedule(const graph_t& graph, const int cntWorkers,
+                                       const phaseSplit_t& split) {
+  const vid_t cntChunks = cntChunksOf(split, graph.cntNodes);
+  const vid_t chunksPerWorker = (cntChunks + cntWorkers - 1) / cntWorkers;
+  vector<vid_t> ends(cntChunks * split.cntPhases);
+  const csrPhaseView_t<graph_t> view = {&graph, ends.data(), split.cntPhases};
+  spacePhasesEvenly(view, split, graph.cntNodes);
+  movePhaseBoundaries(view, split, graph.cntNodes);
+  schedule_t schedule(split.cntPhases, stage_t(cntWorkers));
+  for (vid_t chunk = 0; chunk < cntChunks; chunk++) {
+    const int worker = static_cast<int>(chunk / chunksPerWorker);
+    const vid_t * const phaseEnds = view.phaseEnds(chunk);
+    vid_t v = chunk << split.chunkBits;
+    for (int phase = 0; phase < split.cntPhases; phase++) {
+      for (; v < phaseEnds[phase]; v++) {
+        schedule[phase][worker].push_back(v);
+      }
+    }
+  }
+  return schedule;
+}
+
+//  D1_CHROM: greedily colors vertices in order with the smallest color no
+//  neighbor has, as colorGraph does, then runs one color per stage.
+static inline schedule_t chromaticSchedule(const graph_t& graph, const int cntWorkers) {
+  const vid_t UNCOLORED = static_cast<vid_t>(-1);
+  vector<vid_t> colors(graph.cntNodes, UNCOLORED);
+  vector<vector<vid_t> > nodesByColor;
+  vector<bool> taken;
+  for (vid_t v = 0; v < graph.cntNodes; v++) {
+    taken.assign(graph.offsets[v + 1] - graph.offsets[v] + 1, false);
+    for (vid_t i = graph.offsets[v]; i < graph.offsets[v + 1]; i++) {
+      const vid_t color = colors[graph.edges[i]];
+      if ((color != UNCOLORED) && (color < static_cast<vid_t>(taken.size()))) {
+        taken[color] = true;
+      }
+    }
+    vid_t color = 0;
+    while (taken[color]) {
+      color++;
+    }
+    colors[v] = color;
+    if (color >= static_cast<vid_t>(nodesByColor.size())) {
+      nodesByColor.resize(color + 1);
+    }
+    nodesByColor[color].push_back(v);
+  }
+  schedule_t schedule;
+  for (size_t color = 0; color < nodesByColor.size(); color++) {
+    schedule.push_back(splitAmongWorkers(nodesByColor[color], cntWorkers));
+  }
+  return schedule;
+}
+
+static inline uint64_t mixBits(uint64_t x) {
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+//  BASELINE and D1_PRIO: vertices run roughly in the order of their random
+//  priorities, which the DAG only enforces between neighbors
+static inline schedule_t prioritySchedule(const graph_t& graph, const int cntWorkers) {
+  vector<vid_t> order(graph.cntNodes);
+  for (vid_t v = 0; v < graph.cntNodes; v++) {
+    order[v] = v;
+  }
+  std::sort(order.begin(), order.end(), [](const vid_t a, const vid_t b) {
+    return mixBits(a) > mixBits(b);
+  });
+  return schedule_t(1, splitAmongWorkers(order, cntWorkers));
+}
+
+//  Returns false if the scheduler name is unknown
+//  split gives the chunk bits of chunk and phase, and the phases and the
+//  slack of phase
+static inline bool makeSchedule(const string& scheduler, const graph_t& graph,
+                                const int cntWorkers, const phaseSplit_t& split,
+                                schedule_t * const schedule) {
+  if (scheduler == "bsp") {
+    *schedule = bspSchedule(graph, cntWorkers);
+  } else if (scheduler == "chunk") {
+    const phaseSplit_t onePhase = {split.chunkBits, 1, 0};
+    *schedule = chunkSchedule(graph, cntWorkers, onePhase);
+  } else if (scheduler == "phase") {
+    *schedule = chunkSchedule(graph, cntWorkers, split);
+  } else if (scheduler == "chromatic") {
+    *schedule = chromaticSchedule(graph, cntWorkers);
+  } else if (scheduler == "priority") {
+    *schedule = prioritySchedule(graph, cntWorkers);
+  } else {
+    return false;
+  }
+  return true;
+}
+
+//  The addresses compute's update functions touch: the vertex array
+//  (vertexBytes per vertex, starting at address 0) and, on the next
+//  cache line after it, the edge array.
+struct memoryLayout_t {
+  uint64_t vertexBytes;
+  uint64_t edgesBase;
+};
+typedef struct memoryLayout_t memoryLayout_t;
+
+//  One update of v: read v's own record and edge list, then the record
+//  of every neighbor.  Writing v back would hit in the first level, so it
+//  is left out.
+static inline void replayUpdate(const graph_t& graph, const memoryLayout_t& layout,
+                                const int worker, const vid_t v,
+                                CacheHierarchy * const caches) {
+  const vid_t firstEdge = graph.offsets[v];
+  const vid_t cntEdges = graph.offsets[v + 1] - firstEdge;
+  caches->access(worker, v * layout.vertexBytes, layout.vertexBytes);
+  if (cntEdges > 0) {
+    caches->access(worker, layout.edgesBase + firstEdge * sizeof(vid_t),
+                   cntEdges * sizeof(vid_t));
+  }
+  for (vid_t i = firstEdge; i < firstEdge + cntEdges; i++) {
+    caches->access(worker, graph.edges[i] * layout.vertexBytes, layout.vertexBytes);
+  }
+}
+
+//  Replays one round.  Within a stage, the workers take turns doing one
+//  vertex update each, which approximates them running side by side.
+static inline void replayRound(const graph_t& graph, const memoryLayout_t& layout,
+                               const schedule_t& schedule,
+                               CacheHierarchy * const caches) {
+  for (size_t s = 0; s < schedule.size(); s++) {
+    const stage_t& stage = schedule[s];
+    size_t longest = 0;
+    for (size_t w = 0; w < stage.size(); w++) {
+      longest = std::max(longest, stage[w].size());
+    }
+    for (size_t i = 0; i < longest; i++) {
+      for (size_t w = 0; w < stage.size(); w++) {
+        if (i < stage[w].size()) {
+          replayUpdate(graph, layout, static_cast<int>(w), stage[w][i], caches);
+        }
+      }
+    }
+  }
+}
+
+#endif  // ACCESS_STREAM_H_
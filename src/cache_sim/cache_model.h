@@ -0,0 +1,143 @@
+#ifndef CACHE_MODEL_H_
+#define CACHE_MODEL_H_
+
+#include <cstdint>
+#include <vector>
+#include "./common.h"
+
+using namespace std;
+
+//  The geometry of one level of the hierarchy
+struct cacheConfig_t {
+  uint64_t bytes;
+  int ways;
+};
+typedef struct cacheConfig_t cacheConfig_t;
+
+//  A set-associative cache with LRU replacement that only tracks tags
+class SetAssociativeCache {
+ private:
+  struct way_t {
+    uint64_t line;  //  address / LINE_SIZE, or INVALID_LINE
+    uint64_t lastUse;
+  };
+
+  static const uint64_t INVALID_LINE = UINT64_MAX;
+
+  vector<way_t> ways;
+  uint64_t cntSets;
+  int cntWays;
+  uint64_t clock;
+
+ public:
+  uint64_t accesses;
+  uint64_t misses;
+
+  explicit SetAssociativeCache(const cacheConfig_t& config)
+      : cntSets(config.bytes / (static_cast<uint64_t>(LINE_SIZE) * config.ways)),
+        cntWays(config.ways), clock(0), accesses(0), misses(0) {
+    assert(cntSets > 0);
+    way_t empty = {INVALID_LINE, 0};
+    ways.assign(cntSets * cntWays, empty);
+  }
+
+  //  Looks up the line and makes it the most recently used of its set,
+  //  evicting the least recently used line on a miss.  Returns true on a hit.
+  bool access(const uint64_t line) {
+    accesses++;
+    clock++;
+    way_t * set = &ways[(line % cntSets) * cntWays];
+    way_t * victim = set;
+    for (int i = 0; i < cntWays; i++) {
+      if (set[i].line == line) {
+        set[i].lastUse = clock;
+        return true;
+      }
+      if (set[i].lastUse < victim->lastUse) {
+        victim = &set[i];
+      }
+    }
+    misses++;
+    victim->line = line;
+    victim->lastUse = clock;
+    return false;
+  }
+
+  void resetCounts() {
+    accesses = 0;
+    misses = 0;
+  }
+};
+
+//  Every worker has private copies of all levels but the last one, which
+//  they share.  Lines are filled into each level they missed in, without
+//  enforcing inclusion.
+class CacheHierarchy {
+ private:
+  vector<cacheConfig_t> configs;
+  vector<vector<SetAssociativeCache> > privateLevels;  //  [level][worker]
+  vector<SetAssociativeCache> sharedLevel;  //  empty, or the last level
+
+ public:
+  CacheHierarchy(const vector<cacheConfig_t>& configs, const int cntWorkers)
+      : configs(configs) {
+    assert(!configs.empty());
+    const size_t cntPrivate = (configs.size() > 1) ? configs.size() - 1 : 1;
+    for (size_t level = 0; level < cntPrivate; level++) {
+      privateLevels.push_back(
+        vector<SetAssociativeCache>(cntWorkers, SetAssociativeCache(configs[level])));
+    }
+    if (configs.size() > 1) {
+      sharedLevel.push_back(SetAssociativeCache(configs.back()));
+    }
+  }
+
+  //  Touches every line of [address, address + bytes) on behalf of worker
+  void access(const int worker, const uint64_t address, const uint64_t bytes) {
+    const uint64_t first = address / LINE_SIZE;
+    const uint64_t last = (address + bytes - 1) / LINE_SIZE;
+    for (uint64_t line = first; line <= last; line++) {
+      bool hit = false;
+      for (size_t level = 0; (level < privateLevels.size()) && !hit; level++) {
+        hit = privateLevels[level][worker].access(line);
+      }
+      if (!hit && !sharedLevel.empty()) {
+        sharedLevel[0].access(line);
+      }
+    }
+  }
+
+  size_t cntLevels() const {
+    return configs.size();
+  }
+
+  const cacheConfig_t& config(const size_t level) const {
+    return configs[level];
+  }
+
+  //  Accesses and misses of a level, summed over the workers
+  void counts(const size_t level, uint64_t * const accesses,
+              uint64_t * const misses) const {
+    const vector<SetAssociativeCache>& caches =
+      (level < privateLevels.size()) ? privateLevels[level] : sharedLevel;
+    *accesses = 0;
+    *misses = 0;
+    for (size_t i = 0; i < caches.size(); i++) {
+      *accesses += caches[i].accesses;
+      *misses += caches[i].misses;
+    }
+  }
+
+  void resetCounts() {
+    for (size_t level = 0; level < privateLevels.size(); level++) {
+      for (size_t i = 0; i < privateLevels[level].size(); i++) {
+        privateLevels[level][i].resetCounts();
+      }
+    }
+    for (size_t i = 0; i < sharedLevel.size(); i++) {
+      sharedLevel[i].resetCounts();
+    }
+  }
+};
+
+#endif  // CACHE_MODEL_H_
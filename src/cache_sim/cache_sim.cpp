@@ -0,0 +1,209 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include "./common.h"
+#include "./cache_model.h"
+#include "./access_stream.h"
+#include "../libgraphio/libgraphio.h"
+
+using namespace std;
+
+class CsrEdgeListBuilder : public EdgeListBuilder {
+ private:
+  graph_t * graph;
+
+ public:
+  explicit CsrEdgeListBuilder(graph_t * const graph) : EdgeListBuilder() {
+    this->graph = graph;
+  }
+
+  void set_node_count(vid_t cntNodes) {
+    this->graph->cntNodes = cntNodes;
+    this->graph->offsets.assign(cntNodes + 1, 0);
+  }
+
+  void set_total_edge_count(vid_t totalEdges) {
+    this->graph->cntEdges = totalEdges;
+    this->graph->edges.assign(totalEdges, 0);
+  }
+
+  void set_first_edge_of_node(vid_t nodeid, vid_t firstEdgeIndex) {
+    assert(nodeid < this->graph->cntNodes);
+    this->graph->offsets[nodeid] = firstEdgeIndex;
+  }
+
+  void create_edge(vid_t edgeIndex, vid_t destination) {
+    assert(edgeIndex < this->graph->cntEdges);
+    this->graph->edges[edgeIndex] = destination;
+  }
+
+  void build() {
+    this->graph->offsets[this->graph->cntNodes] = this->graph->cntEdges;
+  }
+};
+
+//  Parses sizes such as 32768, 32K, 256K or 8M
+static inline bool parseBytes(const string& text, uint64_t * const bytes) {
+  char * end;
+  *bytes = strtoull(text.c_str(), &end, 10);
+  if (*end == 'K') {
+    *bytes <<= 10;
+    end++;
+  } else if (*end == 'M') {
+    *bytes <<= 20;
+    end++;
+  } else if (*end == 'G') {
+    *bytes <<= 30;
+    end++;
+  }
+  return (*end == '\0') && (*bytes > 0);
+}
+
+//  Parses a comma-separated list of levels, each written as size:ways,
+//  first level first (e.g., 32K:8,1M:16,32M:16)
+static inline bool parseLevels(const string& text,
+                               vector<cacheConfig_t> * const configs) {
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    size_t end = text.find(',', begin);
+    if (end == string::npos) {
+      end = text.size();
+    }
+    const string level = text.substr(begin, end - begin);
+    const size_t colon = level.find(':');
+    cacheConfig_t config;
+    if ((colon == string::npos) || !parseBytes(level.substr(0, colon), &config.bytes)) {
+      return false;
+    }
+    config.ways = atoi(level.substr(colon + 1).c_str());
+    if ((config.ways <= 0) ||
+        (config.bytes < static_cast<uint64_t>(LINE_SIZE) * config.ways)) {
+      return false;
+    }
+    configs->push_back(config);
+    begin = end + 1;
+  }
+  return !configs->empty();
+}
+
+static inline void printUsage() {
+  cerr << "\nThis program replays the memory accesses of one round of a compute\n"
+       << "scheduler over the vertex order of an edge file through a model of\n"
+       << "set-associative LRU caches, and predicts the miss rate of each level.\n"
+       << "Every worker gets private copies of all levels but the last, which\n"
+       << "is shared.  vertex_bytes is sizeof(vertex_t) of the app and scheduler\n"
+       << "being modeled (the sizeof_vertex column of compute's output).\n"
+       << "phases and slack are NUM_PHASES and PHASE_BOUNDARY_SLACK of phase,\n"
+       << "and are printed as 0 for the other schedulers.\n"
+       << "Usage: ./cache_sim <edge_file> <bsp|chunk|phase|chromatic|priority>"
+       << " [chunk_bits] [workers] [vertex_bytes] [levels] [phases] [slack]\n"
+       << "Defaults: chunk_bits 16, workers 1, vertex_bytes 64,"
+       << " levels 32K:8,256K:8,8M:16, phases 2, slack 25\n"
+       << "Output lines: CACHE_SIM, edge_file, scheduler, chunk_bits, phases,"
+       << " slack, workers, vertex_bytes, level, bytes, ways, accesses, misses,"
+       << " miss_rate, misses_per_edge" << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if ((argc < 3) || (argc > 9)) {
+    cerr << "ERROR: Expected 2 to 8 arguments, received " << argc-1 << '\n';
+    printUsage();
+    return 1;
+  }
+  const string inputEdgeFile = argv[1];
+  const string scheduler = argv[2];
+  const int chunkBits = (argc > 3) ? atoi(argv[3]) : 16;
+  const int cntWorkers = (argc > 4) ? atoi(argv[4]) : 1;
+  const uint64_t vertexBytes = (argc > 5) ? strtoull(argv[5], NULL, 10) : 64;
+  const int cntPhases = (argc > 7) ? atoi(argv[7]) : 2;
+  const int slack = (argc > 8) ? atoi(argv[8]) : 25;
+  vector<cacheConfig_t> configs;
+  if (!parseLevels((argc > 6) ? argv[6] : "32K:8,256K:8,8M:16", &configs)) {
+    cerr << "ERROR: Could not parse the cache levels\n";
+    printUsage();
+    return 1;
+  }
+  if ((chunkBits < 1) || (cntWorkers < 1) || (vertexBytes == 0)) {
+    cerr << "ERROR: chunk_bits, workers and vertex_bytes need to be positive\n";
+    printUsage();
+    return 1;
+  }
+  //  1 << chunk_bits needs to fit in a positive vid_t
+  const int maxChunkBits = 8 * sizeof(vid_t) - 2;
+  if (chunkBits > maxChunkBits) {
+    cerr << "ERROR: chunk_bits need to be at most " << maxChunkBits << '\n';
+    printUsage();
+    return 1;
+  }
+  if ((cntPhases < 1) || (cntPhases > (static_cast<int64_t>(1) << chunkBits))) {
+    cerr << "ERROR: phases need to be between 1 and 1 << chunk_bits\n";
+    printUsage();
+    return 1;
+  }
+  if ((slack < 0) || (slack > 100)) {
+    cerr << "ERROR: slack is a percentage of a phase\n";
+    printUsage();
+    return 1;
+  }
+
+  graph_t graph;
+  graph.cntNodes = 0;
+  graph.cntEdges = 0;
+  CsrEdgeListBuilder builder(&graph);
+  if (edgelistfile_read(inputEdgeFile, &builder) != 0) {
+    return 1;
+  }
+
+  const phaseSplit_t split = {chunkBits, cntPhases, slack};
+  schedule_t schedule;
+  if (!makeSchedule(scheduler, graph, cntWorkers, split, &schedule)) {
+    cerr << "ERROR: Unknown scheduler " << scheduler << '\n';
+    printUsage();
+    return 1;
+  }
+  WHEN_TEST({
+    vector<bool> updated(graph.cntNodes, false);
+    for (size_t s = 0; s < schedule.size(); s++) {
+      for (size_t w = 0; w < schedule[s].size(); w++) {
+        for (size_t i = 0; i < schedule[s][w].size(); i++) {
+          assert(!updated[schedule[s][w][i]]);
+          updated[schedule[s][w][i]] = true;
+        }
+      }
+    }
+    for (vid_t v = 0; v < graph.cntNodes; v++) {
+      assert(updated[v]);
+    }
+  })
+
+  memoryLayout_t layout;
+  layout.vertexBytes = vertexBytes;
+  layout.edgesBase =
+    (graph.cntNodes * vertexBytes + LINE_SIZE - 1) / LINE_SIZE * LINE_SIZE;
+
+  CacheHierarchy caches(configs, cntWorkers);
+  for (int round = 0; round < WARMUP_ROUNDS; round++) {
+    replayRound(graph, layout, schedule, &caches);
+  }
+  caches.resetCounts();
+  replayRound(graph, layout, schedule, &caches);
+
+  const bool phased = (scheduler == "phase");
+  for (size_t level = 0; level < caches.cntLevels(); level++) {
+    uint64_t accesses, misses;
+    caches.counts(level, &accesses, &misses);
+    cout << "CACHE_SIM, " << inputEdgeFile << ", " << scheduler << ", "
+         << chunkBits << ", " << (phased ? cntPhases : 0) << ", "
+         << (phased ? slack : 0) << ", " << cntWorkers << ", " << vertexBytes << ", L"
+         << (level + 1) << ", " << caches.config(level).bytes << ", "
+         << caches.config(level).ways << ", " << accesses << ", " << misses << ", "
+         << setprecision(6)
+         << ((accesses > 0) ? static_cast<double>(misses) / accesses : 0.0) << ", "
+         << static_cast<double>(misses) / std::max(graph.cntEdges, vid_t(1)) << endl;
+  }
+  return 0;
+}
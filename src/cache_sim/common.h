@@ -0,0 +1,55 @@
+#ifndef COMMON_H_
+#define COMMON_H_
+
+#include <cinttypes>
+#include <cassert>
+#include "../libgraphio/libgraphio.h"
+
+#ifndef TEST
+  #define TEST 1
+#endif
+
+#ifndef DEBUG
+  #define DEBUG 0
+#endif
+
+//  cache line size of every modeled level, in bytes
+#ifndef LINE_SIZE
+  #define LINE_SIZE 64
+#endif
+
+//  rounds that are simulated to warm up the caches before the measured one
+#ifndef WARMUP_ROUNDS
+  #define WARMUP_ROUNDS 1
+#endif
+
+// Use WHEN_TEST to conditionally include expensive sanity-checks,
+// when doing more work than simply checking an assertion. For example:
+//
+// uint64_t result = fast_computation_method();
+// WHEN_TEST({
+//   uint64_t expectedResult = slow_but_safe_computation_method();
+//   assert(result == expectedResult);
+// })
+#if TEST
+  #ifdef NDEBUG
+    #error "Cannot run in TEST mode with NDEBUG set! Unset NDEBUG to continue."
+  #endif
+  #define WHEN_TEST(ex) ex
+#else
+  #define WHEN_TEST(ex)
+#endif
+
+// Always wrap your debugging code in WHEN_DEBUG, so it doesn't
+// get included into the executable by accident:
+// WHEN_DEBUG({
+//   printf("Debugging...");
+//   printf("Still debugging...");
+// })
+#if DEBUG
+  #define WHEN_DEBUG(ex) ex
+#else
+  #define WHEN_DEBUG(ex)
+#endif
+
+#endif  // COMMON_H_
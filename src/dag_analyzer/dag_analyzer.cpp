@@ -0,0 +1,198 @@
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include "./common.h"
+#include "./dependency_dag.h"
+#include "../libgraphio/libgraphio.h"
+
+using namespace std;
+
+class CsrEdgeListBuilder : public EdgeListBuilder {
+ private:
+  graph_t * graph;
+
+ public:
+  explicit CsrEdgeListBuilder(graph_t * const graph) : EdgeListBuilder() {
+    this->graph = graph;
+  }
+
+  void set_node_count(vid_t cntNodes) {
+    this->graph->cntNodes = cntNodes;
+    this->graph->offsets.assign(cntNodes + 1, 0);
+  }
+
+  void set_total_edge_count(vid_t totalEdges) {
+    this->graph->cntEdges = totalEdges;
+    this->graph->edges.assign(totalEdges, 0);
+  }
+
+  void set_first_edge_of_node(vid_t nodeid, vid_t firstEdgeIndex) {
+    assert(nodeid < this->graph->cntNodes);
+    this->graph->offsets[nodeid] = firstEdgeIndex;
+  }
+
+  void create_edge(vid_t edgeIndex, vid_t destination) {
+    assert(edgeIndex < this->graph->cntEdges);
+    this->graph->edges[edgeIndex] = destination;
+  }
+
+  void build() {
+    this->graph->offsets[this->graph->cntNodes] = this->graph->cntEdges;
+  }
+};
+
+//  Parses a comma-separated list of non-negative integers (e.g., 8,12,16)
+static inline bool parseList(const string& text, vector<int> * const values) {
+  size_t begin = 0;
+  while (begin <= text.size()) {
+    size_t end = text.find(',', begin);
+    if (end == string::npos) {
+      end = text.size();
+    }
+    char * last;
+    const string value = text.substr(begin, end - begin);
+    values->push_back(static_cast<int>(strtol(value.c_str(), &last, 10)));
+    if (value.empty() || (*last != '\0') || (values->back() < 0)) {
+      return false;
+    }
+    begin = end + 1;
+  }
+  return true;
+}
+
+static inline void printUsage() {
+  cerr << "\nThis program builds the dependencies a D1 scheduler of compute\n"
+       << "enforces within one round over an edge file, and reports the work,\n"
+       << "the span and the longest chain of updates of the resulting DAG.\n"
+       << "prio models BASELINE and D1_PRIO with rotated priorities\n"
+       << "(PRIORITY_GROUP_BITS), chunk models D1_CHUNK, phase models D1_PHASE\n"
+       << "and D1_NUMA (DISTANCE, NUM_PHASES and PHASE_BOUNDARY_SLACK, with the\n"
+       << "same phase boundaries), and chromatic models D1_CHROM.  Every\n"
+       << "combination of the comma-separated lists is analyzed.\n"
+       << "Usage: ./dag_analyzer <edge_file> <prio|chunk|phase|chromatic|all>"
+       << " [chunk_bits_list] [group_bits_list] [distance_list] [phases_list]"
+       << " [slack_list]\n"
+       << "Defaults: chunk_bits 16, group_bits 8, distance 1, phases 2, slack 25\n"
+       << "Output lines: DAG_ANALYZER, edge_file, scheduler, chunk_bits,"
+       << " group_bits, distance, phases, slack, vertices, edges, dependencies,"
+       << " stages, work, span, parallelism, longest_chain\n"
+       << "Parameters a scheduler does not use are printed as 0." << endl;
+}
+
+static inline void printStats(const string& inputEdgeFile, const string& scheduler,
+                              const int chunkBits, const int groupBits,
+                              const int distance, const int cntPhases,
+                              const int slack, const graph_t& graph,
+                              const dag_t& dag) {
+  const dagStats_t stats = analyzeDag(graph, dag);
+  cout << "DAG_ANALYZER, " << inputEdgeFile << ", " << scheduler << ", "
+       << chunkBits << ", " << groupBits << ", " << distance << ", "
+       << cntPhases << ", " << slack << ", "
+       << graph.cntNodes << ", " << graph.cntEdges << ", " << dag.cntDependencies
+       << ", " << dag.cntStages << ", " << stats.work << ", " << stats.span << ", "
+       << setprecision(6)
+       << static_cast<double>(stats.work) / std::max(stats.span, uint64_t(1)) << ", "
+       << stats.longestChain << endl;
+}
+
+int main(int argc, char *argv[]) {
+  if ((argc < 3) || (argc > 8)) {
+    cerr << "ERROR: Expected 2 to 7 arguments, received " << argc-1 << '\n';
+    printUsage();
+    return 1;
+  }
+  const string inputEdgeFile = argv[1];
+  const string scheduler = argv[2];
+  vector<int> chunkBitsList, groupBitsList, distanceList, phasesList, slackList;
+  if (!parseList((argc > 3) ? argv[3] : "16", &chunkBitsList) ||
+      !parseList((argc > 4) ? argv[4] : "8", &groupBitsList) ||
+      !parseList((argc > 5) ? argv[5] : "1", &distanceList) ||
+      !parseList((argc > 6) ? argv[6] : "2", &phasesList) ||
+      !parseList((argc > 7) ? argv[7] : "25", &slackList)) {
+    cerr << "ERROR: Could not parse the parameter lists\n";
+    printUsage();
+    return 1;
+  }
+  //  1 << chunk_bits needs to fit in a positive vid_t
+  const int maxChunkBits = 8 * sizeof(vid_t) - 2;
+  for (size_t i = 0; i < chunkBitsList.size(); i++) {
+    if ((chunkBitsList[i] < 2) || (chunkBitsList[i] > maxChunkBits)) {
+      cerr << "ERROR: chunk_bits need to be between 2 and " << maxChunkBits << '\n';
+      return 1;
+    }
+  }
+  for (size_t i = 0; i < distanceList.size(); i++) {
+    if (distanceList[i] < 1) {
+      cerr << "ERROR: distances need to be positive\n";
+      return 1;
+    }
+  }
+  for (size_t p = 0; p < phasesList.size(); p++) {
+    for (size_t c = 0; c < chunkBitsList.size(); c++) {
+      if ((phasesList[p] < 1)
+          || (phasesList[p] > (static_cast<int64_t>(1) << chunkBitsList[c]))) {
+        cerr << "ERROR: phases need to be between 1 and 1 << chunk_bits\n";
+        return 1;
+      }
+    }
+  }
+  for (size_t s = 0; s < slackList.size(); s++) {
+    if (slackList[s] > 100) {
+      cerr << "ERROR: slack is a percentage of a phase\n";
+      return 1;
+    }
+  }
+  const bool all = (scheduler == "all");
+  if (!all && (scheduler != "prio") && (scheduler != "chunk") &&
+      (scheduler != "phase") && (scheduler != "chromatic")) {
+    cerr << "ERROR: Unknown scheduler " << scheduler << '\n';
+    printUsage();
+    return 1;
+  }
+
+  graph_t graph;
+  graph.cntNodes = 0;
+  graph.cntEdges = 0;
+  CsrEdgeListBuilder builder(&graph);
+  if (edgelistfile_read(inputEdgeFile, &builder) != 0) {
+    return 1;
+  }
+
+  dag_t dag;
+  if (all || (scheduler == "prio")) {
+    for (size_t g = 0; g < groupBitsList.size(); g++) {
+      buildPriorityDag(graph, groupBitsList[g], &dag);
+      printStats(inputEdgeFile, "prio", 0, groupBitsList[g], 0, 0, 0, graph, dag);
+    }
+  }
+  if (all || (scheduler == "chunk")) {
+    for (size_t c = 0; c < chunkBitsList.size(); c++) {
+      const phaseSplit_t split = {chunkBitsList[c], 1, 0};
+      buildChunkDag(graph, split, 1, &dag);
+      printStats(inputEdgeFile, "chunk", chunkBitsList[c], 0, 0, 0, 0, graph, dag);
+    }
+  }
+  if (all || (scheduler == "phase")) {
+    for (size_t c = 0; c < chunkBitsList.size(); c++) {
+      for (size_t d = 0; d < distanceList.size(); d++) {
+        for (size_t p = 0; p < phasesList.size(); p++) {
+          for (size_t s = 0; s < slackList.size(); s++) {
+            const phaseSplit_t split = {chunkBitsList[c], phasesList[p], slackList[s]};
+            buildChunkDag(graph, split, distanceList[d], &dag);
+            printStats(inputEdgeFile, "phase", chunkBitsList[c], 0, distanceList[d],
+                       phasesList[p], slackList[s], graph, dag);
+          }
+        }
+      }
+    }
+  }
+  if (all || (scheduler == "chromatic")) {
+    buildChromaticDag(graph, &dag);
+    printStats(inputEdgeFile, "chromatic", 0, 0, 0, 0, 0, graph, dag);
+  }
+  return 0;
+}
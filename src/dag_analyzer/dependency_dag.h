@@ -0,0 +1,262 @@
+#ifndef DEPENDENCY_DAG_H_
+#define DEPENDENCY_DAG_H_
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "./common.h"
+#include "../graph_compute/phase_boundaries.h"
+
+using namespace std;
+
+//  The graph in compressed sparse row form, as compute lays it out
+struct graph_t {
+  vid_t cntNodes;
+  vid_t cntEdges;
+  vector<vid_t> offsets;  //  cntNodes + 1 entries
+  vector<vid_t> edges;
+};
+typedef struct graph_t graph_t;
+
+//  The order a scheduler imposes on the updates of one round.  Vertices
+//  of different stages are separated by a barrier (the phases of D1_PHASE
+//  and D1_NUMA, the colors of D1_CHROM).  Within a stage, a vertex can
+//  only be updated after all its predecessors.
+struct dag_t {
+  vector<vid_t> offsets;  //  cntNodes + 1 entries
+  vector<vid_t> successors;
+  vector<vid_t> stage;
+  vid_t cntStages;
+  //  successors that need synchronization, i.e., not counting those
+  //  implied by the serial order of the vertices within a chunk
+  vid_t cntDependencies;
+};
+typedef struct dag_t dag_t;
+
+//  All vertices within distance hops of v, without v itself
+static inline void neighborhood(const graph_t& graph, const vid_t v, const int distance,
+                                vector<vid_t> * const neighbors) {
+  neighbors->clear();
+  neighbors->push_back(v);
+  size_t frontierStart = 0;
+  for (int d = 0; d < distance; d++) {
+    const size_t frontierEnd = neighbors->size();
+    for (size_t i = frontierStart; i < frontierEnd; i++) {
+      const vid_t w = (*neighbors)[i];
+      neighbors->insert(neighbors->end(), graph.edges.begin() + graph.offsets[w],
+                        graph.edges.begin() + graph.offsets[w + 1]);
+    }
+    frontierStart = frontierEnd;
+  }
+  std::sort(neighbors->begin(), neighbors->end());
+  neighbors->erase(std::unique(neighbors->begin(), neighbors->end()), neighbors->end());
+  neighbors->erase(std::lower_bound(neighbors->begin(), neighbors->end(), v));
+}
+
+//  Builds the DAG from successors(v, &list), which lists the successors
+//  of v that need synchronization, and ordered(v), which is true if v + 1
+//  follows v in the same serial run of updates.
+template<typename S, typename O>
+static inline void buildDag(const graph_t& graph, S successors, O ordered,
+                            dag_t * const dag) {
+  const vid_t cntNodes = graph.cntNodes;
+  dag->offsets.assign(cntNodes + 1, 0);
+  cilk_for (vid_t v = 0; v < cntNodes; v++) {
+    vector<vid_t> list;
+    successors(v, &list);
+    dag->offsets[v + 1] = list.size() + (ordered(v) ? 1 : 0);
+  }
+  for (vid_t v = 0; v < cntNodes; v++) {
+    dag->offsets[v + 1] += dag->offsets[v];
+  }
+  dag->successors.resize(dag->offsets[cntNodes]);
+  cilk_for (vid_t v = 0; v < cntNodes; v++) {
+    vector<vid_t> list;
+    successors(v, &list);
+    if (ordered(v)) {
+      list.push_back(v + 1);
+    }
+    std::copy(list.begin(), list.end(), dag->successors.begin() + dag->offsets[v]);
+  }
+  dag->cntDependencies = dag->offsets[cntNodes];
+  for (vid_t v = 0; v + 1 < cntNodes; v++) {
+    dag->cntDependencies -= ordered(v) ? 1 : 0;
+  }
+}
+
+//  BASELINE and D1_PRIO: the rotated ids of createPriority in
+//  priority_scheduling.h; every neighbor of higher priority is a successor
+static inline vid_t rotatedPriority(const vid_t id, const int bitsInId,
+                                    const int groupBits) {
+  if (bitsInId <= groupBits) {
+    return id;
+  }
+  const vid_t orderMask = (static_cast<vid_t>(1) << (bitsInId - groupBits)) - 1;
+  return ((id & orderMask) << groupBits) | (id >> (bitsInId - groupBits));
+}
+
+static inline void buildPriorityDag(const graph_t& graph, const int groupBits,
+                                    dag_t * const dag) {
+  int bitsInId = 0;
+  while ((static_cast<vid_t>(1) << bitsInId) < graph.cntNodes) {
+    bitsInId++;
+  }
+  vector<vid_t> priority(graph.cntNodes);
+  cilk_for (vid_t v = 0; v < graph.cntNodes; v++) {
+    priority[v] = rotatedPriority(v, bitsInId, groupBits);
+  }
+  buildDag(graph, [&graph, &priority](const vid_t v, vector<vid_t> * const list) {
+    neighborhood(graph, v, 1, list);
+    list->erase(std::remove_if(list->begin(), list->end(), [&priority, v](const vid_t w) {
+      return priority[w] < priority[v];
+    }), list->end());
+  }, [](const vid_t v) {
+    return false;
+  }, dag);
+  dag->stage.assign(graph.cntNodes, 0);
+  dag->cntStages = 1;
+}
+
+//  interChunkDependency of the chunk schedulers: does w wait for v?
+static inline bool interChunkDependency(const vid_t v, const vid_t w,
+                                        const int chunkBits) {
+  const vid_t chunkMask = (static_cast<vid_t>(1) << chunkBits) - 1;
+  if ((v >> chunkBits) == (w >> chunkBits)) {
+    return false;
+  } else if ((v & chunkMask) == (w & chunkMask)) {
+    return (v < w);
+  } else {
+    return ((v & chunkMask) < (w & chunkMask));
+  }
+}
+
+//  D1_CHUNK (one phase, direct neighbors only), and D1_PHASE and D1_NUMA
+//  (split.cntPhases phases per chunk, whose boundaries createPhaseBoundaries
+//  moves by up to split.slack percent, and neighbors within distance).
+//  Each chunk runs the vertices of a phase in order.
+static inline void buildChunkDag(const graph_t& graph, const phaseSplit_t& split,
+                                 const int distance, dag_t * const dag) {
+  const int chunkBits = split.chunkBits;
+  vector<vid_t> ends(cntChunksOf(split, graph.cntNodes) * split.cntPhases);
+  const csrPhaseView_t<graph_t> view = {&graph, ends.data(), split.cntPhases};
+  spacePhasesEvenly(view, split, graph.cntNodes);
+  movePhaseBoundaries(view, split, graph.cntNodes);
+  vector<vid_t> phase(graph.cntNodes);
+  cilk_for (vid_t v = 0; v < graph.cntNodes; v++) {
+    phase[v] = phaseOf(view, split, v);
+  }
+  buildDag(graph, [&graph, &phase, chunkBits, distance](const vid_t v,
+                                                       vector<vid_t> * const list) {
+    neighborhood(graph, v, distance, list);
+    auto independent = [&phase, chunkBits, v](const vid_t w) {
+      return (phase[v] != phase[w]) || !interChunkDependency(v, w, chunkBits);
+    };
+    list->erase(std::remove_if(list->begin(), list->end(), independent), list->end());
+  }, [&graph, &phase, chunkBits](const vid_t v) {
+    return (v + 1 < graph.cntNodes) && ((v >> chunkBits) == ((v + 1) >> chunkBits))
+      && (phase[v] == phase[v + 1]);
+  }, dag);
+  dag->stage.swap(phase);
+  dag->cntStages = split.cntPhases;
+}
+
+//  D1_CHROM: colorGraph's greedy coloring in vertex order, one color per stage
+static inline void buildChromaticDag(const graph_t& graph, dag_t * const dag) {
+  dag->stage.assign(graph.cntNodes, 0);
+  dag->cntStages = 0;
+  vector<bool> taken;
+  for (vid_t v = 0; v < graph.cntNodes; v++) {
+    taken.assign(graph.offsets[v + 1] - graph.offsets[v] + 1, false);
+    for (vid_t i = graph.offsets[v]; i < graph.offsets[v + 1]; i++) {
+      const vid_t w = graph.edges[i];
+      if ((w < v) && (dag->stage[w] < static_cast<vid_t>(taken.size()))) {
+        taken[dag->stage[w]] = true;
+      }
+    }
+    vid_t color = 0;
+    while (taken[color]) {
+      color++;
+    }
+    dag->stage[v] = color;
+    dag->cntStages = std::max(dag->cntStages, color + 1);
+  }
+  dag->offsets.assign(graph.cntNodes + 1, 0);
+  dag->successors.clear();
+  dag->cntDependencies = 0;
+}
+
+template<typename T>
+static inline void atomicMax(volatile T * const target, const T value) {
+  T current = *target;
+  while ((current < value) && !__sync_bool_compare_and_swap(target, current, value)) {
+    current = *target;
+  }
+}
+
+struct dagStats_t {
+  uint64_t work;  //  one unit per vertex plus one per edge it reads
+  uint64_t span;  //  the most work on any path, summed over the stages
+  vid_t longestChain;  //  the most vertices on any path, summed over the stages
+};
+typedef struct dagStats_t dagStats_t;
+
+//  A parallel topological pass, one level of ready vertices at a time.
+//  A vertex starts when the last of its predecessors has finished.
+static inline dagStats_t analyzeDag(const graph_t& graph, const dag_t& dag) {
+  const vid_t cntNodes = graph.cntNodes;
+  vector<vid_t> remaining(cntNodes, 0);
+  cilk_for (vid_t v = 0; v < cntNodes; v++) {
+    for (vid_t i = dag.offsets[v]; i < dag.offsets[v + 1]; i++) {
+      __sync_add_and_fetch(&remaining[dag.successors[i]], 1);
+    }
+  }
+  vector<uint64_t> start(cntNodes, 0);  //  work done before v can start
+  vector<uint64_t> finish(cntNodes, 0);
+  vector<vid_t> chainBefore(cntNodes, 0);  //  vertices on the longest path to v
+  vector<vid_t> level;
+  for (vid_t v = 0; v < cntNodes; v++) {
+    if (remaining[v] == 0) {
+      level.push_back(v);
+    }
+  }
+  vector<vid_t> nextLevel(cntNodes);
+  vid_t cntVisited = 0;
+  while (!level.empty()) {
+    volatile vid_t cntNext = 0;
+    cilk_for (size_t i = 0; i < level.size(); i++) {
+      const vid_t v = level[i];
+      finish[v] = start[v] + (graph.offsets[v + 1] - graph.offsets[v]) + 1;
+      for (vid_t j = dag.offsets[v]; j < dag.offsets[v + 1]; j++) {
+        const vid_t w = dag.successors[j];
+        atomicMax<uint64_t>(&start[w], finish[v]);
+        atomicMax<vid_t>(&chainBefore[w], chainBefore[v] + 1);
+        if (__sync_sub_and_fetch(&remaining[w], 1) == 0) {
+          nextLevel[__sync_fetch_and_add(&cntNext, 1)] = w;
+        }
+      }
+    }
+    cntVisited += level.size();
+    level.assign(nextLevel.begin(), nextLevel.begin() + cntNext);
+  }
+  //  a cycle would leave vertices unvisited
+  assert(cntVisited == cntNodes);
+
+  vector<uint64_t> stageSpan(dag.cntStages, 0);
+  vector<vid_t> stageChain(dag.cntStages, 0);
+  dagStats_t stats;
+  stats.work = 0;
+  for (vid_t v = 0; v < cntNodes; v++) {
+    stats.work += (graph.offsets[v + 1] - graph.offsets[v]) + 1;
+    stageSpan[dag.stage[v]] = std::max(stageSpan[dag.stage[v]], finish[v]);
+    stageChain[dag.stage[v]] = std::max(stageChain[dag.stage[v]], chainBefore[v] + 1);
+  }
+  stats.span = 0;
+  stats.longestChain = 0;
+  for (vid_t s = 0; s < dag.cntStages; s++) {
+    stats.span += stageSpan[s];
+    stats.longestChain += stageChain[s];
+  }
+  return stats;
+}
+
+#endif  // DEPENDENCY_DAG_H_
@@ -0,0 +1,330 @@
+#ifndef CHECKPOINT_H_
+#define CHECKPOINT_H_
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include "./common.h"
+
+using namespace std;
+
+//  Minimum number of measured compute seconds between two checkpoints
+#ifndef CHECKPOINT_INTERVAL
+  #define CHECKPOINT_INTERVAL 1800.0
+#endif
+
+//  Number of processes the snapshot process forks to write vertex data
+#ifndef CHECKPOINT_WRITERS
+  #define CHECKPOINT_WRITERS 8
+#endif
+
+//  global_t holds heap pointers in these modes, and they cannot be restored
+#if TEST_CONVERGENCE || PRINT_EDGE_LENGTH_HISTOGRAM
+  #define CHECKPOINT_SUPPORTED 0
+#else
+  #define CHECKPOINT_SUPPORTED 1
+#endif
+
+#if IN_PLACE
+  #define CHECKPOINT_DATA_COPIES 1
+#else
+  #define CHECKPOINT_DATA_COPIES 2
+#endif
+
+//  "LAIKACKP" in ASCII
+static const uint64_t CHECKPOINT_MAGIC = 0x4c41494b41434b50;
+
+//  number of vertices packed into one buffer before it is written out
+static const vid_t CHECKPOINT_BLOCK_SIZE = 1 << 16;
+
+enum checkpointStatus_t {
+  CHECKPOINT_RESTORED = 0,
+  CHECKPOINT_NOT_FOUND = 1,
+  CHECKPOINT_INVALID = 2
+};
+
+//  A checkpoint file is laid out as follows:
+//    checkpointHeader_t
+//    global_t
+//    data_t[CHECKPOINT_DATA_COPIES] for every vertex, in vertex order
+struct checkpointHeader_t {
+  uint64_t magic;
+  uint64_t cntNodes;
+  uint64_t cntEdges;
+  uint64_t vertexDataSize;  //  bytes of data_t stored per vertex
+  uint64_t globalDataSize;
+  uint64_t roundsExecuted;
+  double totalSeconds;
+  double initialConvergence;
+};
+typedef struct checkpointHeader_t checkpointHeader_t;
+
+static const size_t CHECKPOINT_VERTEX_BYTES = sizeof(data_t)*CHECKPOINT_DATA_COPIES;
+static const off_t CHECKPOINT_DATA_OFFSET =
+  sizeof(checkpointHeader_t) + sizeof(global_t);
+
+//  Everything the snapshot process needs that takes memory allocation or
+//  string formatting.  The parent is multithreaded, and its forked child
+//  may only make async-signal-safe calls (a lock that another worker held
+//  at fork time is never released in the child), so all of this is set up
+//  before fork(), and the child only opens, writes and closes files.
+struct checkpointJob_t {
+  string filepath;
+  string tmpFilepath;
+  checkpointHeader_t header;
+  char * buffers;  //  one block of packed vertex data per writer
+};
+typedef struct checkpointJob_t checkpointJob_t;
+
+static inline const data_t * vertexDataOf(const vertex_t * const node) {
+#if IN_PLACE
+  return &node->data;
+#else
+  return &node->data[0];
+#endif
+}
+
+static inline data_t * vertexDataOf(vertex_t * const node) {
+#if IN_PLACE
+  return &node->data;
+#else
+  return &node->data[0];
+#endif
+}
+
+//  Only uses async-signal-safe calls, for the snapshot process
+static inline bool writeFully(const int fd, const void * buffer,
+                              size_t numBytes, off_t offset) {
+  const char * bytes = static_cast<const char *>(buffer);
+  if (lseek(fd, offset, SEEK_SET) != offset) {
+    return false;
+  }
+  while (numBytes > 0) {
+    ssize_t written = write(fd, bytes, numBytes);
+    if (written <= 0) {
+      return false;
+    }
+    bytes += written;
+    numBytes -= written;
+  }
+  return true;
+}
+
+static inline bool readFully(const int fd, void * buffer,
+                             size_t numBytes, off_t offset) {
+  char * bytes = static_cast<char *>(buffer);
+  while (numBytes > 0) {
+    ssize_t bytesRead = pread(fd, bytes, numBytes, offset);
+    if (bytesRead <= 0) {
+      return false;
+    }
+    bytes += bytesRead;
+    numBytes -= bytesRead;
+    offset += bytesRead;
+  }
+  return true;
+}
+
+//  Each writer process packs and writes every CHECKPOINT_WRITERS-th block
+//  of vertices through its own file descriptor, so that the writers do
+//  not share a file offset
+static inline bool writeCheckpointBlocks(const checkpointJob_t * const job,
+                                         const int writerID,
+                                         const vertex_t * const nodes) {
+  int fd = open(job->tmpFilepath.c_str(), O_WRONLY);
+  if (fd < 0) {
+    return false;
+  }
+  char * buffer = &job->buffers[writerID*CHECKPOINT_BLOCK_SIZE*CHECKPOINT_VERTEX_BYTES];
+  const vid_t cntNodes = static_cast<vid_t>(job->header.cntNodes);
+  bool failed = false;
+  for (vid_t start = writerID*CHECKPOINT_BLOCK_SIZE;
+       (start < cntNodes) && !failed;
+       start += CHECKPOINT_WRITERS*CHECKPOINT_BLOCK_SIZE) {
+    vid_t end = std::min(start + CHECKPOINT_BLOCK_SIZE, cntNodes);
+    for (vid_t v = start; v < end; v++) {
+      memcpy(&buffer[(v - start)*CHECKPOINT_VERTEX_BYTES],
+             vertexDataOf(&nodes[v]), CHECKPOINT_VERTEX_BYTES);
+    }
+    failed = !writeFully(fd, buffer, (end - start)*CHECKPOINT_VERTEX_BYTES,
+                         CHECKPOINT_DATA_OFFSET + start*CHECKPOINT_VERTEX_BYTES);
+  }
+  failed |= (close(fd) != 0);
+  return !failed;
+}
+
+//  Writes the checkpoint to a temporary file and renames it into place,
+//  so a crash while writing never destroys the previous checkpoint.
+//  Runs in the snapshot process, which is single-threaded, so the
+//  writers are forked rather than started as threads.
+static inline int writeCheckpointFile(const checkpointJob_t * const job,
+                                      const vertex_t * const nodes,
+                                      const global_t * const globaldata) {
+  int fd = open(job->tmpFilepath.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0644);
+  if (fd < 0) {
+    return -1;
+  }
+  bool failed = !writeFully(fd, &job->header, sizeof(checkpointHeader_t), 0)
+    || !writeFully(fd, globaldata, sizeof(global_t), sizeof(checkpointHeader_t));
+
+  pid_t writers[CHECKPOINT_WRITERS];
+  int cntWriters = 0;
+  for (int i = 0; (i < CHECKPOINT_WRITERS) && !failed; i++) {
+    pid_t pid = fork();
+    if (pid == 0) {
+      _exit(writeCheckpointBlocks(job, i, nodes) ? 0 : 1);
+    } else if (pid < 0) {
+      failed = true;
+    } else {
+      writers[cntWriters++] = pid;
+    }
+  }
+  for (int i = 0; i < cntWriters; i++) {
+    int status;
+    if ((waitpid(writers[i], &status, 0) != writers[i])
+        || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      failed = true;
+    }
+  }
+
+  failed |= (fsync(fd) != 0);
+  failed |= (close(fd) != 0);
+  if (failed || (rename(job->tmpFilepath.c_str(), job->filepath.c_str()) != 0)) {
+    unlink(job->tmpFilepath.c_str());
+    return -1;
+  }
+  return 0;
+}
+
+//  Snapshots vertex and global data without stalling the computation:
+//  a forked child sees a copy-on-write image of the address space and
+//  writes it out while the parent goes back to computing rounds.
+//  At most one snapshot is in flight; if the previous one has not
+//  finished yet, this checkpoint is skipped and false is returned.
+static inline bool startCheckpoint(const string& filepath,
+                                   const vertex_t * const nodes,
+                                   const vid_t cntNodes,
+                                   const vid_t cntEdges,
+                                   const global_t * const globaldata,
+                                   const int roundsExecuted,
+                                   const double totalSeconds,
+                                   const double initialConvergence,
+                                   pid_t * const inFlight) {
+  if (*inFlight != 0) {
+    int status;
+    pid_t result = waitpid(*inFlight, &status, WNOHANG);
+    if (result == 0) {
+      return false;
+    }
+    if ((result < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+      cerr << "WARNING: Writing checkpoint " << filepath << " failed" << endl;
+    }
+    *inFlight = 0;
+  }
+
+  checkpointJob_t job;
+  job.filepath = filepath;
+  job.tmpFilepath = filepath + ".tmp";
+  job.header.magic = CHECKPOINT_MAGIC;
+  job.header.cntNodes = cntNodes;
+  job.header.cntEdges = cntEdges;
+  job.header.vertexDataSize = CHECKPOINT_VERTEX_BYTES;
+  job.header.globalDataSize = sizeof(global_t);
+  job.header.roundsExecuted = roundsExecuted;
+  job.header.totalSeconds = totalSeconds;
+  job.header.initialConvergence = initialConvergence;
+  job.buffers = new (std::nothrow)
+    char[CHECKPOINT_WRITERS*CHECKPOINT_BLOCK_SIZE*CHECKPOINT_VERTEX_BYTES];
+  if (job.buffers == NULL) {
+    cerr << "WARNING: Could not allocate the checkpoint buffers" << endl;
+    return false;
+  }
+
+  //  don't let the child inherit (and later lose) buffered output
+  cout.flush();
+  pid_t pid = fork();
+  if (pid == 0) {
+    _exit(writeCheckpointFile(&job, nodes, globaldata) == 0 ? 0 : 1);
+  }
+  //  the child has its own copy of the buffers
+  delete[] job.buffers;
+  if (pid < 0) {
+    cerr << "WARNING: Could not fork checkpoint writer: " << strerror(errno) << endl;
+    return false;
+  }
+  *inFlight = pid;
+  return true;
+}
+
+//  Blocks until the checkpoint in flight (if any) is written
+static inline void finishCheckpoint(const string& filepath, pid_t * const inFlight) {
+  if (*inFlight == 0) {
+    return;
+  }
+  int status;
+  pid_t result = waitpid(*inFlight, &status, 0);
+  if ((result < 0) || !WIFEXITED(status) || (WEXITSTATUS(status) != 0)) {
+    cerr << "WARNING: Writing checkpoint " << filepath << " failed" << endl;
+  }
+  *inFlight = 0;
+}
+
+//  Restores vertex data, global data and progress counters from filepath.
+//  Scheduler data is not part of the checkpoint, so this must be called
+//  after init_scheduling.
+static inline checkpointStatus_t readCheckpoint(const string& filepath,
+                                                vertex_t * const nodes,
+                                                const vid_t cntNodes,
+                                                const vid_t cntEdges,
+                                                global_t * const globaldata,
+                                                checkpointHeader_t * const outHeader) {
+  int fd = open(filepath.c_str(), O_RDONLY);
+  if (fd < 0) {
+    return (errno == ENOENT) ? CHECKPOINT_NOT_FOUND : CHECKPOINT_INVALID;
+  }
+  checkpointHeader_t header;
+  if (!readFully(fd, &header, sizeof(checkpointHeader_t), 0)
+      || (header.magic != CHECKPOINT_MAGIC)
+      || (header.cntNodes != static_cast<uint64_t>(cntNodes))
+      || (header.cntEdges != static_cast<uint64_t>(cntEdges))
+      || (header.vertexDataSize != CHECKPOINT_VERTEX_BYTES)
+      || (header.globalDataSize != sizeof(global_t))
+      || !readFully(fd, globaldata, sizeof(global_t), sizeof(checkpointHeader_t))) {
+    close(fd);
+    return CHECKPOINT_INVALID;
+  }
+
+  const vid_t cntBlocks = (cntNodes + CHECKPOINT_BLOCK_SIZE - 1) / CHECKPOINT_BLOCK_SIZE;
+  volatile bool failed = false;
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    const vid_t start = block*CHECKPOINT_BLOCK_SIZE;
+    const vid_t end = std::min(start + CHECKPOINT_BLOCK_SIZE, cntNodes);
+    char * buffer = new (std::nothrow) char[(end - start)*CHECKPOINT_VERTEX_BYTES];
+    if ((buffer == NULL)
+        || !readFully(fd, buffer, (end - start)*CHECKPOINT_VERTEX_BYTES,
+                      CHECKPOINT_DATA_OFFSET + start*CHECKPOINT_VERTEX_BYTES)) {
+      failed = true;
+    } else {
+      for (vid_t v = start; v < end; v++) {
+        memcpy(vertexDataOf(&nodes[v]),
+               &buffer[(v - start)*CHECKPOINT_VERTEX_BYTES], CHECKPOINT_VERTEX_BYTES);
+      }
+    }
+    delete[] buffer;
+  }
+  close(fd);
+  if (failed) {
+    return CHECKPOINT_INVALID;
+  }
+  *outHeader = header;
+  return CHECKPOINT_RESTORED;
+}
+
+#endif  // CHECKPOINT_H_
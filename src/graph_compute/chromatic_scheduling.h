@@ -5,6 +5,7 @@
 
 #include <algorithm>
 #include "./common.h"
+#include "./memory_accounting.h"
 
 struct scheddata_t {
   vid_t cntColors;  //  total number of colors used
@@ -31,6 +32,7 @@ static inline void testColoring(vertex_t * const nodes,
   }
 }
 
+//  Greedily colors the graph in vertex order; returns the number of colors
 static inline vid_t colorGraph(vertex_t * const nodes,
                               const vid_t cntNodes,
                               vid_t * const colorAssignments) {
@@ -65,7 +67,8 @@ static inline vid_t colorGraph(vertex_t * const nodes,
   WHEN_TEST(
     testColoring(nodes, cntNodes, colorAssignments);
   )
-  return maxColor;
+  //  colors are numbered from 0, so there is one more than the largest
+  return maxColor + 1;
 }
 
 static inline void init_scheduling(vertex_t * const nodes,
@@ -77,6 +80,9 @@ static inline void init_scheduling(vertex_t * const nodes,
   //  how many vertices are there per color
   scheddata->cntNodesPerColor = new (std::nothrow) vid_t[scheddata->cntColors + 1]();
   scheddata->nodesByColor = new (std::nothrow) vid_t[cntNodes];
+  trackAllocation("cntNodesPerColor", scheddata->cntNodesPerColor,
+                  sizeof(vid_t) * (scheddata->cntColors + 1));
+  trackAllocation("nodesByColor", scheddata->nodesByColor, sizeof(vid_t) * cntNodes);
   //  we count up color assignments per color
   //  the +1 exists so that we can take the difference between subsequent colors
   //  in the next block to find indices into the nodesByColor array
@@ -0,0 +1,190 @@
+#ifndef CHUNK_PHASES_H_
+#define CHUNK_PHASES_H_
+
+//  The phases that D1_PHASE and D1_NUMA split their chunks into.  Include
+//  after chunkdata_t (with its phaseEndIndex[NUM_PHASES]) is defined.
+
+#if D1_PHASE || D1_NUMA
+
+#include <vector>
+#include <algorithm>
+#include "./common.h"
+#include "./numa_init.h"
+#include "./reduction.h"
+#include "./memory_accounting.h"
+#include "./phase_boundaries.h"
+
+#if NUM_PHASES < 1
+  #error "NUM_PHASES needs to be at least 1"
+#elif NUM_PHASES > (1 << CHUNK_BITS)
+  #error "Every phase needs at least one vertex, so increase CHUNK_BITS"
+#endif
+
+#if (PHASE_BOUNDARY_SLACK < 0) || (PHASE_BOUNDARY_SLACK > 100)
+  #error "PHASE_BOUNDARY_SLACK is a percentage of a phase"
+#endif
+
+static inline int phaseOf(const vid_t v, const chunkdata_t * const chunkdata) {
+  return phaseIn(chunkdata[v >> CHUNK_BITS].phaseEndIndex, v);
+}
+
+static inline bool samePhase(vid_t v, vid_t w, chunkdata_t * const chunkdata) {
+  return (phaseOf(v, chunkdata) == phaseOf(w, chunkdata));
+}
+
+//  The graph and the phase boundaries, as phase_boundaries.h sees them
+struct chunkPhaseView_t {
+  vertex_t * nodes;
+  chunkdata_t * chunkdata;
+  vid_t degree(const vid_t v) const { return nodes[v].cntEdges; }
+  vid_t edge(const vid_t v, const vid_t k) const { return nodes[v].edges[k]; }
+  vid_t * phaseEnds(const vid_t chunk) const { return chunkdata[chunk].phaseEndIndex; }
+};
+typedef struct chunkPhaseView_t chunkPhaseView_t;
+
+//  Spaces the phases of every chunk evenly, then moves the boundaries to
+//  cut the edges between chunks that fall in the same phase (see
+//  movePhaseBoundaries).  With DISTANCE > 1, the edges are a proxy for the
+//  dependencies.
+static inline void createPhaseBoundaries(vertex_t * const nodes,
+                                         const vid_t cntNodes,
+                                         chunkdata_t * const chunkdata) {
+  const chunkPhaseView_t view = {nodes, chunkdata};
+  const phaseSplit_t split = {CHUNK_BITS, NUM_PHASES, PHASE_BOUNDARY_SLACK};
+  spacePhasesEvenly(view, split, cntNodes);
+  if ((NUM_PHASES == 1) || (PHASE_BOUNDARY_SLACK == 0)) {
+    return;
+  }
+  const uint64_t cntEvenEdges = samePhaseCrossChunkEdges(view, split, cntNodes);
+  const int passes = movePhaseBoundaries(view, split, cntNodes);
+  printf("SamePhaseCrossChunkEdges, even, moved, passes: %lu %lu %d\n",
+         static_cast<uint64_t>(cntEvenEdges),
+         static_cast<uint64_t>(samePhaseCrossChunkEdges(view, split, cntNodes)),
+         passes);
+}
+
+static inline bool interChunkDependency(vid_t v, vid_t w) {
+  static const vid_t chunkMask = (1 << CHUNK_BITS) - 1;
+  if ((v >> CHUNK_BITS) == (w >> CHUNK_BITS)) {
+    return false;
+  } else if ((v & chunkMask) == (w & chunkMask)) {
+    return (v < w);
+  } else {
+    return ((v & chunkMask) < (w & chunkMask));
+  }
+}
+
+//  Gathers the vertices within DISTANCE hops of v, v included, sorted.
+//  frontier holds the vertices the last hop found first, and then the
+//  edges of those, sorted, of which only the ones not seen yet are merged
+//  into neighbors and become the next frontier.
+static inline void gatherNeighborhood(vertex_t * const nodes, const vid_t v,
+                                      std::vector<vid_t> * const neighbors,
+                                      std::vector<vid_t> * const frontier) {
+  neighbors->assign(1, v);
+  frontier->assign(1, v);
+  for (int d = 0; (d < DISTANCE) && !frontier->empty(); d++) {
+    const size_t frontierEnd = frontier->size();
+    for (size_t i = 0; i < frontierEnd; i++) {
+      const vertex_t * node = &nodes[(*frontier)[i]];
+      frontier->insert(frontier->end(), node->edges, node->edges + node->cntEdges);
+    }
+    std::sort(frontier->begin() + frontierEnd, frontier->end());
+    //  the new vertices are written over the old frontier, which is never
+    //  overtaken, since frontierEnd > 0
+    size_t cntNew = 0;
+    size_t seen = 0;
+    vid_t previous = v;
+    for (size_t i = frontierEnd; i < frontier->size(); i++) {
+      const vid_t w = (*frontier)[i];
+      if ((i > frontierEnd) && (w == previous)) {
+        continue;
+      }
+      previous = w;
+      while ((seen < neighbors->size()) && ((*neighbors)[seen] < w)) {
+        seen++;
+      }
+      if ((seen == neighbors->size()) || ((*neighbors)[seen] != w)) {
+        (*frontier)[cntNew++] = w;
+      }
+    }
+    frontier->resize(cntNew);
+    const size_t cntSeen = neighbors->size();
+    neighbors->insert(neighbors->end(), frontier->begin(), frontier->end());
+    std::inplace_merge(neighbors->begin(), neighbors->begin() + cntSeen,
+                       neighbors->end());
+  }
+}
+
+//  Sets dependencies, cntDependentEdges and dependentEdges of every
+//  vertex, from its neighbors within DISTANCE in the same phase of other
+//  chunks, and returns the number of dependent edges.  Blocks of vertices
+//  are handled in parallel, once to count and once to fill in the
+//  dependent edges, and a prefix sum over the counts joins the two.
+static inline vid_t calculatePhaseDependencies(vertex_t * const nodes,
+                                               const vid_t cntNodes,
+                                               chunkdata_t * const chunkdata,
+                                               vid_t ** const dependentEdges) {
+  const vid_t cntBlocks = (cntNodes + REDUCTION_BLOCK_SIZE - 1) >> REDUCTION_BLOCK_BITS;
+  vid_t * dependentEdgeIndex = new (std::nothrow) vid_t[cntNodes + 1];
+  assert(dependentEdgeIndex != NULL);
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    std::vector<vid_t> neighbors;
+    std::vector<vid_t> frontier;
+    const vid_t start = block << REDUCTION_BLOCK_BITS;
+    const vid_t end = std::min(start + REDUCTION_BLOCK_SIZE, cntNodes);
+    for (vid_t i = start; i < end; i++) {
+      gatherNeighborhood(nodes, i, &neighbors, &frontier);
+      sched_t * node = &nodes[i].sched;
+      node->dependencies = 0;
+      node->cntDependentEdges = 0;
+      const int phase = phaseOf(i, chunkdata);
+      for (size_t k = 0; k < neighbors.size(); k++) {
+        const vid_t neighbor = neighbors[k];
+        if (phaseOf(neighbor, chunkdata) == phase) {
+          if (interChunkDependency(neighbor, i)) {
+            node->dependencies++;
+          } else if (interChunkDependency(i, neighbor)) {
+            node->cntDependentEdges++;
+          }
+        }
+      }
+      node->satisfied = node->dependencies;
+      dependentEdgeIndex[i] = node->cntDependentEdges;
+    }
+  }
+  const vid_t cntDependencies = parallelPrefixSum(dependentEdgeIndex, cntNodes);
+
+  numaInit_t numaInit(NUMA_WORKERS,
+                      CHUNK_BITS, static_cast<bool>(NUMA_INIT));
+  *dependentEdges =
+    static_cast<vid_t *>(numaCalloc(numaInit, sizeof(vid_t), cntDependencies+1));
+  trackAllocation("dependentEdges", *dependentEdges,
+                  sizeof(vid_t) * (cntDependencies + 1));
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    std::vector<vid_t> neighbors;
+    std::vector<vid_t> frontier;
+    const vid_t start = block << REDUCTION_BLOCK_BITS;
+    const vid_t end = std::min(start + REDUCTION_BLOCK_SIZE, cntNodes);
+    for (vid_t i = start; i < end; i++) {
+      nodes[i].sched.dependentEdges = &(*dependentEdges)[dependentEdgeIndex[i]];
+      gatherNeighborhood(nodes, i, &neighbors, &frontier);
+      const int phase = phaseOf(i, chunkdata);
+      vid_t curIndex = dependentEdgeIndex[i];
+      for (size_t k = 0; k < neighbors.size(); k++) {
+        const vid_t neighbor = neighbors[k];
+        if ((phaseOf(neighbor, chunkdata) == phase)
+            && interChunkDependency(i, neighbor)) {
+          (*dependentEdges)[curIndex++] = neighbor;
+        }
+      }
+      assert(curIndex == dependentEdgeIndex[i] + nodes[i].sched.cntDependentEdges);
+    }
+  }
+  delete[] dependentEdgeIndex;
+  return cntDependencies;
+}
+
+#endif  // D1_PHASE || D1_NUMA
+
+#endif  // CHUNK_PHASES_H_
@@ -5,33 +5,52 @@
 
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
+#include "./concurrent_queue.h"
+#include "./chunk_trace.h"
+#include "./memory_accounting.h"
 
 #ifndef CHUNK_BITS
   #define CHUNK_BITS 16
 #endif
 
 struct chunkdata_t {
-  vid_t nextIndex;  // the next vertex in this chunk to be processed
+  volatile vid_t nextIndex;  // the next vertex in this chunk to be processed
   vid_t endIndex;   // the index of the first vertex beyond this chunk
-  vid_t firstInterChunkIndex;
 };
 typedef struct chunkdata_t chunkdata_t;
 
+//  Every chunk has a home work queue, which holds it at the start of a
+//  round and whenever it becomes ready again after being shelved.  A chunk
+//  is in at most one queue at a time, so a queue never holds more than
+//  chunksPerQueue chunks.
 struct scheddata_t {
   chunkdata_t * chunkdata;
   vid_t cntChunks;
+  mrmw_queue_t ** workQueues;  //  one per worker
+  vid_t * queueData;  //  data array for the work queues
+  int cntQueues;
+  vid_t chunksPerQueue;
+  volatile vid_t remainingChunks;  //  chunks not yet finished this round
 };
 typedef struct scheddata_t scheddata_t;
 
 struct sched_t {
   vid_t dependencies;
-  vid_t satisfied;
+  volatile vid_t satisfied;
+  //  the end of the run of interior vertices starting here, or this
+  //  vertex itself if it has edges into other chunks
+  vid_t interiorEnd;
 };
 typedef struct sched_t sched_t;
 
 // update_function.h depends on sched_t being defined
 #include "./update_function.h"
 
+static const vid_t NO_CHUNK = static_cast<vid_t>(-1);
+//  satisfied of the vertex a shelved chunk waits on, once it is ready
+static const vid_t SHELVED = static_cast<vid_t>(-1);
+
 static inline bool interChunkDependency(vid_t v, vid_t w) {
   static const vid_t chunkMask = (1 << CHUNK_BITS) - 1;
   if ((v >> CHUNK_BITS) == (w >> CHUNK_BITS)) {
@@ -85,24 +104,52 @@ static void createChunkData(vertex_t * const nodes, const vid_t cntNodes,
   scheddata->cntChunks = (cntNodes + (1 << CHUNK_BITS) - 1) >> CHUNK_BITS;
   scheddata->chunkdata = new (std::nothrow) chunkdata_t[scheddata->cntChunks];
   assert(scheddata->chunkdata != NULL);
+  trackAllocation("chunkdata", scheddata->chunkdata,
+                  sizeof(chunkdata_t) * scheddata->cntChunks);
 
+  vid_t cntInterior = 0;
   cilk_for (vid_t i = 0; i < scheddata->cntChunks; ++i) {
-    scheddata->chunkdata[i].endIndex = std::min((i + 1) << CHUNK_BITS, cntNodes);
     chunkdata_t * chunk = &scheddata->chunkdata[i];
-    chunk->firstInterChunkIndex = cntNodes + 1;
-    for (vid_t j = chunk->nextIndex; j < chunk->endIndex; ++j) {
-      for (vid_t k = 0; k < nodes[j].cntEdges; ++k) {
-        if (((nodes[j].edges[k] >> CHUNK_BITS) != i) &&
-            (chunk->firstInterChunkIndex != cntNodes + 1)) {  // different chunk
-          chunk->firstInterChunkIndex = j;
-          j = chunk->endIndex;
-          break;
-        }
+    chunk->nextIndex = i << CHUNK_BITS;
+    chunk->endIndex = std::min((i + 1) << CHUNK_BITS, cntNodes);
+    //  A vertex without edges into other chunks has neither inter-chunk
+    //  dependencies nor successors, and only the chunk's own serial order
+    //  needs to be respected.  Needs orderEdgesByChunk.
+    vid_t runEnd = chunk->endIndex;
+    vid_t cntChunkInterior = 0;
+    for (vid_t j = chunk->endIndex; j-- > chunk->nextIndex;) {
+      if ((nodes[j].sched.dependencies > 0) || ((nodes[j].cntEdges > 0)
+          && interChunkDependency(j, nodes[j].edges[0]))) {
+        runEnd = j;
+      } else {
+        cntChunkInterior++;
       }
+      nodes[j].sched.interiorEnd = runEnd;
     }
-    if (chunk->firstInterChunkIndex == cntNodes + 1) {
-      chunk->firstInterChunkIndex = chunk->endIndex;
-    }
+    __sync_fetch_and_add(&cntInterior, cntChunkInterior);
+  }
+  printf("InteriorVertices: %lu\n", static_cast<uint64_t>(cntInterior));
+}
+
+static void createWorkQueues(scheddata_t * const scheddata) {
+  scheddata->cntQueues = getMaxWorkers();
+  scheddata->chunksPerQueue =
+    (scheddata->cntChunks + scheddata->cntQueues - 1) / scheddata->cntQueues;
+  int queueBits = 0;
+  while ((static_cast<vid_t>(1) << queueBits) < scheddata->chunksPerQueue) {
+    queueBits++;
+  }
+  scheddata->queueData =
+    new (std::nothrow) vid_t[static_cast<size_t>(scheddata->cntQueues) << queueBits];
+  assert(scheddata->queueData != NULL);
+  trackAllocation("queueData", scheddata->queueData,
+                  (sizeof(vid_t) * scheddata->cntQueues) << queueBits);
+  scheddata->workQueues = new (std::nothrow) mrmw_queue_t *[scheddata->cntQueues];
+  assert(scheddata->workQueues != NULL);
+  for (int i = 0; i < scheddata->cntQueues; i++) {
+    scheddata->workQueues[i] = new (std::nothrow) mrmw_queue_t(
+      &scheddata->queueData[static_cast<size_t>(i) << queueBits], queueBits, NO_CHUNK);
+    assert(scheddata->workQueues[i] != NULL);
   }
 }
 
@@ -112,6 +159,73 @@ void init_scheduling(vertex_t * const nodes, const vid_t cntNodes,
   orderEdgesByChunk(nodes, cntNodes);
   calculateNodeDependenciesChunk(nodes, cntNodes);
   createChunkData(nodes, cntNodes, scheddata);
+  createWorkQueues(scheddata);
+}
+
+//  Updates the vertices of a chunk in order until it is done or reaches
+//  a vertex that still waits on another chunk, and returns the index it
+//  stopped at.  In the latter case, it shelves the chunk: taking one
+//  extra count off the vertex's satisfied makes whoever takes off the last
+//  count see SHELVED and push the chunk back on its home queue.  If that
+//  is us, the vertex became ready in the meantime and we just go on.
+static inline vid_t processChunk(vertex_t * const nodes,
+                                 scheddata_t * const scheddata,
+                                 global_t * const globaldata,
+                                 const int round, const vid_t chunk) {
+  chunkdata_t * chunkdata = &scheddata->chunkdata[chunk];
+  vid_t j = chunkdata->nextIndex;
+  for (; j < chunkdata->endIndex; j++) {
+    //  interior vertices need no counters checked or counted down
+    for (const vid_t runEnd = nodes[j].sched.interiorEnd; j < runEnd; j++) {
+      update(nodes, j, globaldata, round);
+    }
+    if (j == chunkdata->endIndex) {
+      break;
+    }
+    sched_t * const node = &nodes[j].sched;
+    if ((node->satisfied != SHELVED) && (node->satisfied > 0)) {
+      //  whoever requeues the chunk may pick it up right away
+      chunkdata->nextIndex = j;
+      if (__sync_sub_and_fetch(&node->satisfied, 1) != SHELVED) {
+        return j;
+      }
+    }
+    update(nodes, j, globaldata, round);
+    node->satisfied = node->dependencies;
+    //  the inter-chunk successors are at the front of the edges list
+    for (vid_t k = 0; (k < nodes[j].cntEdges)
+                      && interChunkDependency(j, nodes[j].edges[k]); k++) {
+      const vid_t successor = nodes[j].edges[k];
+      if (__sync_sub_and_fetch(&nodes[successor].sched.satisfied, 1) == SHELVED) {
+        const vid_t enabledChunk = successor >> CHUNK_BITS;
+        scheddata->workQueues[enabledChunk / scheddata->chunksPerQueue]->push(
+          enabledChunk);
+      }
+    }
+  }
+  chunkdata->nextIndex = j;
+  return j;
+}
+
+//  Processes a chunk taken from a work queue until it finishes or blocks.
+//  Blocked chunks are not looked at again until they are ready.  Returns
+//  true if it finished the chunk.
+static inline bool processReadyChunk(vertex_t * const nodes,
+                                     scheddata_t * const scheddata,
+                                     global_t * const globaldata,
+                                     const int round, const vid_t chunk,
+                                     const bool stolen) {
+  #if CHUNK_TRACE
+    const vid_t firstIndex = scheddata->chunkdata[chunk].nextIndex;
+    const uint64_t chunkStart = readCycleCounter();
+  #endif
+  const vid_t stopIndex = processChunk(nodes, scheddata, globaldata, round, chunk);
+  const bool finished = (stopIndex == scheddata->chunkdata[chunk].endIndex);
+  #if CHUNK_TRACE
+    traceChunk(chunkStart, chunk, stopIndex - firstIndex, round, 0,
+               (finished ? 0 : TRACE_SHELVED) | (stolen ? TRACE_STOLEN : 0));
+  #endif
+  return finished;
 }
 
 static inline
@@ -124,58 +238,53 @@ void execute_rounds(const int numRounds, vertex_t * const nodes,
       cout << "Running chunk round" << round << endl;
     })
 
-    for (vid_t i = 0; i < scheddata->cntChunks; i++) {
-      scheddata->chunkdata[i].nextIndex = i << CHUNK_BITS;
-    }
-
-    volatile bool doneFlag = false;
-    while (!doneFlag) {
-      doneFlag = true;
-      cilk_for (vid_t i = 0; i < scheddata->cntChunks; i++) {
-        vid_t j = scheddata->chunkdata[i].nextIndex;
-
-        // Optimization disabled due to correctness problem
-        // for (; j < scheddata->chunkdata[i].firstInterChunkIndex; j++) {
-        //   update(nodes, j);
-        // }
-
-        bool localDoneFlag = false;
-        while (!localDoneFlag && (j < scheddata->chunkdata[i].endIndex)) {
-          if (nodes[j].sched.satisfied == 0) {
-            update(nodes, j, globaldata, round);
-            nodes[j].sched.satisfied = nodes[j].sched.dependencies;
-            vid_t k = 0;
-            while (k < nodes[j].cntEdges) {
-              if (interChunkDependency(j, nodes[j].edges[k])) {
-                __sync_sub_and_fetch(&nodes[nodes[j].edges[k]].sched.satisfied, 1);
-                k++;
-              } else {
-                break;
-              }
-            }
-          } else {
-            scheddata->chunkdata[i].nextIndex = j;
-            localDoneFlag = true;  // we couldn't process one of the nodes, so break
-            doneFlag = false;  // we couldn't process one, so we need another round
-          }
-          j++;
-        }
-        if (!localDoneFlag) {
-          scheddata->chunkdata[i].nextIndex = j;
-        }
+    scheddata->remainingChunks = scheddata->cntChunks;
+    //  a worker steals from one random queue at a time; the round is over
+    //  once every chunk has finished
+    const int cntQueues = scheddata->cntQueues;
+    runWorkStealingRound(cntQueues, NO_CHUNK, [scheddata](const int w) {
+      const vid_t begin = std::min(w * scheddata->chunksPerQueue, scheddata->cntChunks);
+      const vid_t end = std::min(begin + scheddata->chunksPerQueue, scheddata->cntChunks);
+      for (vid_t i = begin; i < end; i++) {
+        scheddata->chunkdata[i].nextIndex = i << CHUNK_BITS;
       }
-    }
+      scheddata->workQueues[w]->push(begin, end);
+    }, [scheddata](const int w) {
+      return scheddata->workQueues[w]->pop();
+    }, [scheddata, cntQueues](const int w, victimPicker_t * const picker) {
+      //  the worker's own queue was just found empty
+      const int victim = picker->next(cntQueues);
+      return (victim == w) ? NO_CHUNK : scheddata->workQueues[victim]->pop();
+    }, [nodes, scheddata, globaldata, round](const int w, const vid_t chunk,
+                                             const bool stolen) {
+      return static_cast<vid_t>(
+        processReadyChunk(nodes, scheddata, globaldata, round, chunk, stolen) ? 1 : 0);
+    }, [scheddata](const vid_t cntFinished) {
+      if (cntFinished > 0) {
+        __sync_sub_and_fetch(&scheddata->remainingChunks, cntFinished);
+      }
+      return (scheddata->remainingChunks == 0);
+    });
   }
 }
 
 static inline
 void cleanup_scheduling(vertex_t * const nodes, const vid_t cntNodes,
                         scheddata_t * const scheddata) {
+#if CHUNK_TRACE
+  writeChunkTrace();
+#endif
   delete[] scheddata->chunkdata;
+  for (int i = 0; i < scheddata->cntQueues; i++) {
+    delete scheddata->workQueues[i];
+  }
+  delete[] scheddata->workQueues;
+  delete[] scheddata->queueData;
 }
 
 static inline void print_execution_data() {
   cout << "Chunk size bits: " << CHUNK_BITS << '\n';
+  cout << "Work queues: " << getMaxWorkers() << '\n';
 }
 
 #endif  // D1_CHUNK
@@ -0,0 +1,198 @@
+#ifndef CHUNK_TRACE_H_
+#define CHUNK_TRACE_H_
+
+#include "./common.h"
+
+#if CHUNK_TRACE
+
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <algorithm>
+#include <iostream>
+#include "./reduction.h"
+#include "./timing.h"
+
+using namespace std;
+
+//  number of events each worker keeps; older events are overwritten
+#ifndef CHUNK_TRACE_EVENTS
+  #define CHUNK_TRACE_EVENTS (1 << 16)
+#endif
+
+#if (CHUNK_TRACE_EVENTS & (CHUNK_TRACE_EVENTS - 1)) != 0
+  #error "CHUNK_TRACE_EVENTS needs to be a power of two"
+#endif
+
+enum chunkTraceKind_t {
+  TRACE_CHUNK = 0,  //  a worker processing a chunk until it was done or shelved
+  TRACE_BARRIER = 1,  //  a worker waiting for the others at the end of a phase
+  TRACE_PASS = 2  //  one parallel pass over all chunks (D1_PHASE)
+};
+
+static const uint8_t TRACE_SHELVED = 1;
+static const uint8_t TRACE_STOLEN = 2;
+
+struct chunkTraceEvent_t {
+  uint64_t start;  //  time stamp counter values
+  uint64_t end;
+  vid_t chunk;
+  vid_t vertices;  //  vertices updated
+  int32_t round;
+  int16_t phase;
+  uint8_t kind;
+  uint8_t flags;
+};
+typedef struct chunkTraceEvent_t chunkTraceEvent_t;
+
+//  there is one of these per worker, each on its own cache line
+struct chunkTraceRow_t {
+  chunkTraceEvent_t * events;  //  allocated by the worker on its first event
+  uint64_t cntEvents;  //  events recorded; only the last CHUNK_TRACE_EVENTS are kept
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+typedef struct chunkTraceRow_t chunkTraceRow_t;
+
+static inline chunkTraceRow_t * chunkTraceRows() {
+  static chunkTraceRow_t rows[MAX_WORKERS];
+  return rows;
+}
+
+//  The time stamp counter and the monotonic clock read at the first
+//  event; comparing them again at the end calibrates the counter.
+struct chunkTraceClock_t {
+  uint64_t cycles;
+  struct timespec time;
+  chunkTraceClock_t() : cycles(readCycleCounter()), time(monotonicNow()) { }
+};
+typedef struct chunkTraceClock_t chunkTraceClock_t;
+
+static inline const chunkTraceClock_t& chunkTraceClock() {
+  static const chunkTraceClock_t clock;
+  return clock;
+}
+
+static inline void recordTraceEvent(const chunkTraceEvent_t& event) {
+  const int worker = getWorkerNumber();
+  assert(worker < MAX_WORKERS);
+  chunkTraceRow_t * row = &chunkTraceRows()[worker];
+  if (row->events == NULL) {
+    chunkTraceClock();
+    row->events = new (std::nothrow) chunkTraceEvent_t[CHUNK_TRACE_EVENTS];
+    assert(row->events != NULL);
+  }
+  row->events[row->cntEvents & (CHUNK_TRACE_EVENTS - 1)] = event;
+  row->cntEvents++;
+}
+
+//  Records a chunk that has been processed from start until now
+static inline void traceChunk(const uint64_t start, const vid_t chunk,
+                              const vid_t vertices, const int round, const int phase,
+                              const uint8_t flags) {
+  chunkTraceEvent_t event;
+  event.start = start;
+  event.end = readCycleCounter();
+  event.chunk = chunk;
+  event.vertices = vertices;
+  event.round = round;
+  event.phase = static_cast<int16_t>(phase);
+  event.kind = TRACE_CHUNK;
+  event.flags = flags;
+  recordTraceEvent(event);
+}
+
+static inline void traceInterval(const chunkTraceKind_t kind, const uint64_t start,
+                                 const uint64_t end, const int round, const int phase) {
+  chunkTraceEvent_t event;
+  event.start = start;
+  event.end = end;
+  event.chunk = 0;
+  event.vertices = 0;
+  event.round = round;
+  event.phase = static_cast<int16_t>(phase);
+  event.kind = kind;
+  event.flags = 0;
+  recordTraceEvent(event);
+}
+
+//  Writes all recorded events in the Chrome trace event format (viewable
+//  in chrome://tracing and Perfetto) to the file named by the environment
+//  variable CHUNK_TRACE_FILE (chunk_trace.json by default).
+static inline void writeChunkTrace() {
+  const char * filepath = getenv("CHUNK_TRACE_FILE");
+  if (filepath == NULL) {
+    filepath = "chunk_trace.json";
+  }
+  FILE * file = fopen(filepath, "w");
+  if (file == NULL) {
+    cerr << "WARNING: Could not write chunk trace to " << filepath << endl;
+    return;
+  }
+
+  const chunkTraceClock_t& clock = chunkTraceClock();
+  const uint64_t cycles = readCycleCounter() - clock.cycles;
+  const double microseconds = secondsBetween(clock.time, monotonicNow()) * 1e6;
+  const double cyclesPerMicrosecond =
+    (microseconds > 0.0) ? (static_cast<double>(cycles) / microseconds) : 1.0;
+  static const char * const KIND_NAMES[] = {"chunk", "barrier", "pass"};
+
+  //  time stamps are relative to the earliest event that was kept
+  const chunkTraceRow_t * rows = chunkTraceRows();
+  uint64_t origin = UINT64_MAX;
+  for (int worker = 0; worker < MAX_WORKERS; worker++) {
+    const uint64_t cntEvents = std::min(rows[worker].cntEvents,
+                                        static_cast<uint64_t>(CHUNK_TRACE_EVENTS));
+    for (uint64_t i = 0; i < cntEvents; i++) {
+      origin = std::min(origin, rows[worker].events[i].start);
+    }
+  }
+
+  fprintf(file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [\n");
+  bool first = true;
+  for (int worker = 0; worker < MAX_WORKERS; worker++) {
+    if (rows[worker].events == NULL) {
+      continue;
+    }
+    fprintf(file, "%s{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": 0, "
+                  "\"tid\": %d, \"args\": {\"name\": \"worker %d\"}}",
+            first ? "" : ",\n", worker, worker);
+    first = false;
+    const uint64_t cntEvents = rows[worker].cntEvents;
+    const uint64_t firstEvent =
+      (cntEvents > CHUNK_TRACE_EVENTS) ? (cntEvents - CHUNK_TRACE_EVENTS) : 0;
+    for (uint64_t i = firstEvent; i < cntEvents; i++) {
+      const chunkTraceEvent_t& event =
+        rows[worker].events[i & (CHUNK_TRACE_EVENTS - 1)];
+      const double ts = (event.start - origin) / cyclesPerMicrosecond;
+      const double dur = (event.end - event.start) / cyclesPerMicrosecond;
+      if (event.kind == TRACE_CHUNK) {
+        fprintf(file, ",\n{\"name\": \"chunk %" PRIu64 "%s\", \"cat\": \"chunk\", "
+                      "\"ph\": \"X\", \"ts\": %.3f, \"dur\": %.3f, "
+                      "\"pid\": 0, \"tid\": %d, "
+                      "\"args\": {\"chunk\": %" PRIu64 ", \"vertices\": %" PRIu64 ", "
+                      "\"round\": %d, \"phase\": %d, \"shelved\": %s, \"stolen\": %s}}",
+                static_cast<uint64_t>(event.chunk),
+                (event.flags & TRACE_SHELVED) ? " (shelved)" : "", ts, dur, worker,
+                static_cast<uint64_t>(event.chunk), static_cast<uint64_t>(event.vertices),
+                event.round, event.phase,
+                (event.flags & TRACE_SHELVED) ? "true" : "false",
+                (event.flags & TRACE_STOLEN) ? "true" : "false");
+      } else {
+        fprintf(file, ",\n{\"name\": \"%s\", \"cat\": \"%s\", \"ph\": \"X\", "
+                      "\"ts\": %.3f, \"dur\": %.3f, \"pid\": 0, \"tid\": %d, "
+                      "\"args\": {\"round\": %d, \"phase\": %d}}",
+                KIND_NAMES[event.kind], KIND_NAMES[event.kind], ts, dur, worker,
+                event.round, event.phase);
+      }
+    }
+    if (cntEvents > CHUNK_TRACE_EVENTS) {
+      cerr << "WARNING: worker " << worker << " dropped the first "
+           << (cntEvents - CHUNK_TRACE_EVENTS) << " trace events" << endl;
+    }
+  }
+  fprintf(file, "\n]}\n");
+  fclose(file);
+}
+
+#endif  // CHUNK_TRACE
+
+#endif  // CHUNK_TRACE_H_
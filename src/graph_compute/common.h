@@ -99,6 +99,45 @@
   #define NUMA_STEAL 1
 #endif
 
+//  D1_NUMA steals from the nearest workers first: SMT siblings, then
+//  cores sharing the last-level cache, then the NUMA node, then all.
+//  A thief moves to the next level after this many failed steals in a
+//  row; 0 picks victims uniformly from all other workers.
+#ifndef NUMA_STEAL_ATTEMPTS
+  #define NUMA_STEAL_ATTEMPTS 4
+#endif
+
+//  this switch makes compute count hardware events around every call
+//  to execute_rounds, with one counter group per worker thread
+#ifndef PERF_COUNTERS
+  #define PERF_COUNTERS 0
+#endif
+
+//  this switch makes every D1_NUMA worker count the chunks it pops,
+//  steals and shelves, and the cycles it spends waiting at the barrier
+#ifndef NUMA_TELEMETRY
+  #define NUMA_TELEMETRY 0
+#endif
+
+//  this switch makes the D1_NUMA, D1_CHUNK and D1_PHASE schedulers record
+//  when each worker ran, shelved or waited, and write the events out as
+//  a Chrome trace (see chunk_trace.h)
+#ifndef CHUNK_TRACE
+  #define CHUNK_TRACE 0
+#endif
+
+//  D1_PHASE and D1_NUMA split every chunk into NUM_PHASES phases, separated
+//  by barriers.  At init, each boundary between phases may move up to
+//  PHASE_BOUNDARY_SLACK percent of a phase away from its evenly spaced
+//  position, to cut the dependencies between chunks (see chunk_phases.h).
+#ifndef NUM_PHASES
+  #define NUM_PHASES 2
+#endif
+
+#ifndef PHASE_BOUNDARY_SLACK
+  #define PHASE_BOUNDARY_SLACK 25
+#endif
+
 #ifndef NUMA_INIT
   #define NUMA_INIT 0
 #endif
@@ -135,6 +174,31 @@
   #define TEST_CONVERGENCE 0
 #endif
 
+//  this switch computes the convergence data inside update() during
+//  the last round before each convergence check, instead of in a
+//  separate pass over the graph
+#ifndef FUSED_CONVERGENCE
+  #define FUSED_CONVERGENCE 0
+#endif
+
+//  this switch lets the convergence experiment choose the number of
+//  rounds between convergence checks from the observed convergence rate;
+//  otherwise it always runs CONVERGENCE_CHECK_INTERVAL rounds
+#ifndef ADAPTIVE_CONVERGENCE_CHECKS
+  #define ADAPTIVE_CONVERGENCE_CHECKS 1
+#endif
+
+//  the fixed interval, and the largest adaptive interval, in rounds
+#ifndef CONVERGENCE_CHECK_INTERVAL
+  #define CONVERGENCE_CHECK_INTERVAL 250
+#endif
+
+//  the adaptive interval keeps the time spent on convergence checks
+//  below this fraction of the time spent computing rounds
+#ifndef CONVERGENCE_CHECK_OVERHEAD
+  #define CONVERGENCE_CHECK_OVERHEAD 0.05
+#endif
+
 #ifndef USE_GLOBAL_REST_LENGTH
   #define USE_GLOBAL_REST_LENGTH 1
 #endif
@@ -142,6 +206,19 @@
 #ifndef USE_RANDOM_PRIORITY_HASH
   #define USE_RANDOM_PRIORITY_HASH 0
 #endif
+
+//  how BASELINE and D1_PRIO assign priorities (see priority_scheduling.h):
+//  0 rotates the PRIORITY_GROUP_BITS of the id, 1 hashes the id,
+//  2 orders by decreasing degree, 3 orders by the offset within a chunk
+//  of CHUNK_BITS, and 4 is a random permutation, seeded by the
+//  environment variable PRIORITY_SEED or else anew on every run
+#ifndef PRIORITY_POLICY
+  #if USE_RANDOM_PRIORITY_HASH
+    #define PRIORITY_POLICY 1
+  #else
+    #define PRIORITY_POLICY 0
+  #endif
+#endif
 //  this switch allows you to print the histogram
 //  of the edge lengths in the graph, centered
 //  on the average edge length as measured at T=0
@@ -197,6 +274,10 @@
   #define cilk_sync
 #endif
 
+#ifndef CACHE_LINE_SIZE
+  #define CACHE_LINE_SIZE 64
+#endif
+
 #include <cinttypes>
 #include <cassert>
 #include "../libgraphio/libgraphio.h"
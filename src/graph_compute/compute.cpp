@@ -14,27 +14,34 @@ using namespace std;
 
 #include "./common.h"
 #include "./concurrent_queue.h"
+#include "./checkpoint.h"
+#include "./reduction.h"
+#include "./timing.h"
+#include "./perf_counters.h"
+#include "./memory_accounting.h"
 
 uint64_t hashOfGraphData(const vertex_t * const nodes,
                          const vid_t cntNodes) {
-  uint64_t result = 0;
-  for (vid_t i = 0; i < cntNodes; i++) {
-  #if IN_PLACE
-    result ^= hashOfVertexData(&nodes[i].data);
-  #else
-    result ^= hashOfVertexData(&nodes[i].data[0]);
-  #endif
-  }
-  return result;
+  return parallelReduce<uint64_t>(cntNodes, 0,
+    [nodes](const vid_t start, const vid_t end) {
+      uint64_t result = 0;
+      for (vid_t i = start; i < end; i++) {
+      #if IN_PLACE
+        result ^= hashOfVertexData(&nodes[i].data);
+      #else
+        result ^= hashOfVertexData(&nodes[i].data[0]);
+      #endif
+      }
+      return result;
+    },
+    [](const uint64_t a, const uint64_t b) { return a ^ b; });
 }
 
 vid_t getEdgeCount(vertex_t * const nodes,
                    const vid_t cntNodes) {
-  vid_t result = 0;
-  for (vid_t i = 0; i < cntNodes; i++) {
-    result += nodes[i].cntEdges;
-  }
-  return result;
+  return parallelSum<vid_t>(cntNodes, [nodes](const vid_t i) {
+    return nodes[i].cntEdges;
+  });
 }
 
 WHEN_TEST(
@@ -71,14 +78,119 @@ void test_queue() {
   cout << "numBits = " << numBits << endl;
   cout << "Sum1 = " << sum << endl;
   cout << "Sum2 = " << sum2 << endl;
+  free(const_cast<vid_t *>(tmpData));
+  free(const_cast<vid_t *>(tmpResult));
+}
+
+void test_deque() {
+  cout << "Testing Work-Stealing Deque" << endl;
+  static const vid_t numBits = 20;
+  static const vid_t SENTINEL = static_cast<vid_t>(-1);
+  numaInit_t numaInit(NUMA_WORKERS, CHUNK_BITS, static_cast<bool>(NUMA_INIT));
+  volatile vid_t * tmpData = static_cast<vid_t *>(numaCalloc(numaInit,
+      sizeof(vid_t), (1 << numBits)));
+  volatile vid_t * tmpResult = static_cast<vid_t *>(numaCalloc(numaInit,
+      sizeof(vid_t), (1 << numBits)));
+
+  ws_deque_t D(tmpData, numBits);
+
+  //  the owner takes the newest value, thieves steal the oldest
+  D.push(0, 3);
+  assert(D.take() == 2);
+  assert(D.steal() == 0);
+  assert(D.take() == 1);
+  assert(D.take() == SENTINEL);
+  assert(D.steal() == SENTINEL);
+
+  //  an empty range pushes nothing
+  D.push(3, 0);
+  assert(D.take() == SENTINEL);
+  D.push(7);
+  assert(D.steal() == 7);
+
+  //  concurrent thieves get every value exactly once
+  D.push(0, 1 << numBits);
+  cilk_for (vid_t i = 0; i < (1 << numBits); i++) {
+    tmpResult[i] = SENTINEL;
+    while (tmpResult[i] == SENTINEL) {
+      tmpResult[i] = D.steal();
+    }
+  }
+  assert(D.steal() == SENTINEL);
+
+  vid_t sum = 0;
+  vid_t sum2 = 0;
+  for (vid_t i = 0; i < (1 << numBits); i++) {
+    sum += tmpResult[i];
+    sum2 += i;
+  }
+  assert(sum == sum2);
+  cout << "Sum1 = " << sum << endl;
+  cout << "Sum2 = " << sum2 << endl;
+  free(const_cast<vid_t *>(tmpData));
+  free(const_cast<vid_t *>(tmpResult));
+}
+
+//  The number of rounds after which the preprocessing in init_scheduling
+//  is repaid by faster rounds, compared to D0_BSP, whose init_scheduling
+//  does nothing; loading and filling in data cost the same for every
+//  scheduler.  The D0_BSP time per million edges on the same input is read
+//  from the environment variable BSP_TIME_PER_MILLION_EDGES.  Returns -1
+//  if it is not set, and infinity if this scheduler's rounds are not faster.
+static inline double breakEvenRounds(const startupTimes_t& startupTimes,
+                                     const double timePerMillionEdges,
+                                     const vid_t cntEdges) {
+#if D0_BSP
+  return 0.0;
+#else
+  const char * bspTimePerMillionEdges = getenv("BSP_TIME_PER_MILLION_EDGES");
+  if (bspTimePerMillionEdges == NULL) {
+    return -1.0;
+  }
+  const double savedPerMillionEdges = strtod(bspTimePerMillionEdges, NULL)
+    - timePerMillionEdges;
+  if (savedPerMillionEdges <= 0.0) {
+    return INFINITY;
+  }
+  const double savedPerRound =
+    savedPerMillionEdges * static_cast<double>(cntEdges) / 1000000.0;
+  return ceil(startupTimes.initScheduling / savedPerRound);
+#endif
+}
+
+static inline void printStartupTimes(const startupTimes_t& startupTimes,
+                                     const double breakEven) {
+  cout << "Load time: " << setprecision(8) << startupTimes.load << "s\n";
+#if TEST_SIMPLE_AND_UNDIRECTED
+  cout << "Simple and undirected check time: " << setprecision(8)
+       << startupTimes.checkGraph << "s\n";
+#endif
+  cout << "init_scheduling time: " << setprecision(8)
+       << startupTimes.initScheduling << "s\n";
+  cout << "fillInNodeData time: " << setprecision(8)
+       << startupTimes.fillInNodeData << "s\n";
+  cout << "fillInGlobalData time: " << setprecision(8)
+       << startupTimes.fillInGlobalData << "s\n";
+  cout << "Total startup time: " << setprecision(8) << startupTimes.total() << "s\n";
+  cout << "Break-even rounds vs. BSP: ";
+  if (breakEven < 0.0) {
+    cout << "unknown (set BSP_TIME_PER_MILLION_EDGES)\n";
+  } else if (std::isinf(breakEven)) {
+    cout << "never\n";
+  } else {
+    cout << breakEven << '\n';
+  }
 }
 
 static inline void printVerboseOutput(const vertex_t * const nodes,
-                                      const vid_t cntNodes, const int numRounds,
+                                      const vid_t cntNodes, const vid_t cntEdges,
+                                      const int numRounds,
                                       const global_t * const globaldata,
                                       const double seconds,
                                       const double timePerMillionEdges,
-                                      const double initialConvergenceData) {
+                                      const double initialConvergenceData,
+                                      const startupTimes_t& startupTimes,
+                                      const double breakEven) {
   cout << "Done computing " << numRounds << " rounds!\n";
   cout << "Time taken:     " << setprecision(8) << seconds << "s\n";
   cout << "Time per round: " << setprecision(8) << seconds / numRounds << "s\n";
@@ -96,8 +208,16 @@ static inline void printVerboseOutput(const vertex_t * const nodes,
     cout << 0 << '\n';
   #endif
 
+  printStartupTimes(startupTimes, breakEven);
+
   print_execution_data();
 
+#if NEEDS_SCHEDULER_DATA
+  printMemoryUsage(cntNodes, cntEdges, sizeof(sched_t) * cntNodes);
+#else
+  printMemoryUsage(cntNodes, cntEdges, 0);
+#endif
+
   cout << "Debug flag: " << DEBUG << '\n';
   cout << "Test flag: " << TEST << '\n';
 }
@@ -109,7 +229,9 @@ static inline void printCompactOutput(const string& inputEdgeFile,
                                       const global_t * const globaldata,
                                       const double seconds,
                                       const double timePerMillionEdges,
-                                      const double initialConvergenceData) {
+                                      const double initialConvergenceData,
+                                      const startupTimes_t& startupTimes,
+                                      const double breakEven) {
   cout << APP_NAME << ", ";
   cout << SCHEDULER_NAME << ", ";
   cout << IN_PLACE << ", ";
@@ -147,7 +269,15 @@ static inline void printCompactOutput(const string& inputEdgeFile,
   cout << NUMA_STEAL << ", ";
   cout << DISTANCE << ", ";
   cout << __DATE__ << ", ";
-  cout << __TIME__ << endl;
+  cout << __TIME__ << ", ";
+  cout << setprecision(8) << startupTimes.load << ", ";
+  cout << setprecision(8) << startupTimes.checkGraph << ", ";
+  cout << setprecision(8) << startupTimes.initScheduling << ", ";
+  cout << setprecision(8) << startupTimes.fillInNodeData << ", ";
+  cout << setprecision(8) << startupTimes.fillInGlobalData << ", ";
+  cout << breakEven << ", ";
+  cout << trackedBytes() << ", ";
+  cout << peakResidentKiB() << endl;
 }
 
 static inline void printConvergenceExperimentHeader(const string& inputEdgeFile,
@@ -199,23 +329,101 @@ static inline void printConvergenceExperimentData(const int roundsExecuted,
   cout << setprecision(8) << currentConvergence << endl;
 }
 
-static void prepareTestRun(const char * const inputEdgeFile,
+//  first interval of an adaptive run, before any rate has been observed
+static const int INITIAL_CONVERGENCE_CHECK_INTERVAL = 8;
+
+//  extrapolating from a short batch is unreliable, so an adaptive
+//  interval may grow by at most this factor from one check to the next
+static const double CONVERGENCE_CHECK_GROWTH = 2.0;
+
+//  Picks the number of rounds before the next convergence check.
+//  The convergence data is assumed to decay geometrically, so the rate
+//  observed over the last batch predicts the round at which the cutoff
+//  is reached, and the next check is scheduled for that round.  The
+//  interval is never so short that checking takes more than
+//  CONVERGENCE_CHECK_OVERHEAD of the compute time.
+static inline int nextConvergenceCheckInterval(const int lastInterval,
+                                               const double lastSeconds,
+                                               const double checkSeconds,
+                                               const double lastConvergence,
+                                               const double currentConvergence,
+                                               const double cutoffConvergence,
+                                               const int roundsLeft) {
+#if ADAPTIVE_CONVERGENCE_CHECKS
+  double rounds = CONVERGENCE_CHECK_INTERVAL;
+  if ((currentConvergence > 0.0) && (currentConvergence < lastConvergence)) {
+    const double ratePerRound = log(lastConvergence / currentConvergence) / lastInterval;
+    rounds = ceil(log(currentConvergence / cutoffConvergence) / ratePerRound);
+  }
+  rounds = min(rounds, lastInterval * CONVERGENCE_CHECK_GROWTH);
+
+  const double secondsPerRound = lastSeconds / lastInterval;
+  if (secondsPerRound > 0.0) {
+    const double budgetPerRound = CONVERGENCE_CHECK_OVERHEAD * secondsPerRound;
+    rounds = max(rounds, ceil(checkSeconds / budgetPerRound));
+  }
+  rounds = min(rounds, static_cast<double>(min(CONVERGENCE_CHECK_INTERVAL, roundsLeft)));
+  int interval = max(static_cast<int>(rounds), 1);
+#else
+  int interval = min(CONVERGENCE_CHECK_INTERVAL, roundsLeft);
+#endif
+
+#if IN_PLACE == 0
+  //  execute_rounds starts every batch with round 0, so an odd batch
+  //  would leave the current data in the wrong buffer.  Rounding up must
+  //  not run past roundsLeft, so an odd interval that already reaches it
+  //  is rounded down instead.  Only a single round left still makes for
+  //  an odd (final) batch.
+  if (interval & 1) {
+    interval += (interval < roundsLeft) ? 1 : -1;
+  }
+  interval = min(max(interval, 2), roundsLeft);
+#endif
+  return interval;
+}
+
+void test_convergence_check_interval() {
+  cout << "Testing Convergence Check Intervals" << endl;
+  //  no batch runs past the rounds left, however slowly the data converges
+  const int maxRoundsLeft = 2*CONVERGENCE_CHECK_INTERVAL + 1;
+  for (int roundsLeft = 1; roundsLeft <= maxRoundsLeft; roundsLeft++) {
+    for (int lastInterval = 1; lastInterval < maxRoundsLeft; lastInterval++) {
+      const int interval = nextConvergenceCheckInterval(lastInterval, 1.0, 0.0,
+                                                        1.0, 0.999, 0.5, roundsLeft);
+      assert((interval >= 1) && (interval <= roundsLeft));
+#if IN_PLACE == 0
+      assert(((interval & 1) == 0) || (roundsLeft == 1));
+#endif
+    }
+  }
+  assert(nextConvergenceCheckInterval(2, 1.0, 0.0, 1.0, 0.999, 0.5, 1) == 1);
+}
+
+//  If checkpointFile names an existing checkpoint, vertex and global data
+//  are restored from it instead of being initialized, and true is returned.
+static bool prepareTestRun(const char * const inputEdgeFile,
                            const char * const vertexMetaDataFile,
                            const int numRounds,
                            vertex_t ** const outNodes,
                            vid_t * const outCntNodes,
                            vid_t * const outCntEdges,
                            scheddata_t * const outSchedData,
-                           global_t * const outGlobalData) {
+                           global_t * const outGlobalData,
+                           startupTimes_t * const outTimes,
+                           const char * const checkpointFile = NULL,
+                           checkpointHeader_t * const outCheckpoint = NULL) {
   vertex_t * nodes;
   vid_t cntNodes;
   vid_t cntEdges;
+  startupTimes_t times = startupTimes_t();
+  struct timespec lapStart = monotonicNow();
 
   numaInit_t numaInit(NUMA_WORKERS, CHUNK_BITS, static_cast<bool>(NUMA_INIT));
 
   int result = readEdgesFromFile(inputEdgeFile, &nodes, &cntNodes, numaInit);
   assert(result == 0);
   cntEdges = getEdgeCount(nodes, cntNodes);
+  times.load = lapSeconds(&lapStart);
 
 #if TEST_SIMPLE_AND_UNDIRECTED
   //  This function asserts that there are
@@ -223,6 +431,7 @@ static void prepareTestRun(const char * const inputEdgeFile,
   //  reciprocated (i.e., if (v,w) exists, then
   //  so does (w,v))
   testSimpleAndUndirected(nodes, cntNodes);
+  times.checkGraph = lapSeconds(&lapStart);
 #endif
 
 #if VERBOSE
@@ -238,17 +447,35 @@ static void prepareTestRun(const char * const inputEdgeFile,
   #endif
 #endif
 
+  lapStart = monotonicNow();
   init_scheduling(nodes, cntNodes, outSchedData);
+  times.initScheduling = lapSeconds(&lapStart);
+
+  checkpointStatus_t checkpointStatus = CHECKPOINT_NOT_FOUND;
+  if (checkpointFile != NULL) {
+    checkpointStatus = readCheckpoint(checkpointFile, nodes, cntNodes, cntEdges,
+                                      outGlobalData, outCheckpoint);
+    if (checkpointStatus == CHECKPOINT_INVALID) {
+      cerr << "\nERROR: Checkpoint " << checkpointFile
+           << " is unreadable or was written for a different graph." << endl;
+      exit(1);
+    }
+  }
 
-//  This switch indicates whether the app needs an auxiliary
-//  file to initialize node data
-#if VERTEX_META_DATA
-  fillInNodeData(nodes, cntNodes, vertexMetaDataFile);
-#else
-  fillInNodeData(nodes, cntNodes);
-#endif
+  if (checkpointStatus != CHECKPOINT_RESTORED) {
+    lapStart = monotonicNow();
+  //  This switch indicates whether the app needs an auxiliary
+  //  file to initialize node data
+  #if VERTEX_META_DATA
+    fillInNodeData(nodes, cntNodes, vertexMetaDataFile);
+  #else
+    fillInNodeData(nodes, cntNodes);
+  #endif
+    times.fillInNodeData = lapSeconds(&lapStart);
 
-  fillInGlobalData(nodes, cntNodes, outGlobalData, numRounds);
+    fillInGlobalData(nodes, cntNodes, outGlobalData, numRounds);
+    times.fillInGlobalData = lapSeconds(&lapStart);
+  }
 
 #if PRINT_EDGE_LENGTH_HISTOGRAM
   initialEdgeLengthHistogram(nodes, cntNodes, outGlobalData);
@@ -257,6 +484,8 @@ static void prepareTestRun(const char * const inputEdgeFile,
   *outNodes = nodes;
   *outCntNodes = cntNodes;
   *outCntEdges = cntEdges;
+  *outTimes = times;
+  return (checkpointStatus == CHECKPOINT_RESTORED);
 }
 
 int main_fixed_number_of_rounds(int argc, char *argv[]) {
@@ -266,11 +495,11 @@ int main_fixed_number_of_rounds(int argc, char *argv[]) {
   vid_t cntEdges;
   char * inputEdgeFile;
   char * vertexMetaDataFile = NULL;
-  int result = 0;
   int numRounds = 0;
 
 WHEN_TEST({
   test_queue();
+  test_deque();
 })
 
 #if VERTEX_META_DATA
@@ -299,8 +528,10 @@ WHEN_TEST({
   scheddata_t scheddata;
   global_t globaldata;
 
+  startupTimes_t startupTimes;
+
   prepareTestRun(inputEdgeFile, vertexMetaDataFile, numRounds, &nodes, &cntNodes,
-                 &cntEdges, &scheddata, &globaldata);
+                 &cntEdges, &scheddata, &globaldata, &startupTimes);
 
   /////////////////////////////////////////////////////////////////////
   ///                     RUNNING THE EXPERIMENT                    ///
@@ -313,9 +544,10 @@ WHEN_TEST({
     execute_rounds(2, nodes, cntNodes, &scheddata, &globaldata);
   #endif
 
-  struct timespec starttime, endtime;
-  result = clock_gettime(CLOCK_MONOTONIC, &starttime);
-  assert(result == 0);
+#if PERF_COUNTERS
+  startPerfBatch();
+#endif
+  const struct timespec starttime = monotonicNow();
 
   execute_rounds(numRounds, nodes, cntNodes, &scheddata, &globaldata);
   WHEN_TEST({
@@ -324,12 +556,10 @@ WHEN_TEST({
     assert(roundUpdateCount == static_cast<uint64_t>(cntNodes)*numRounds);
   })
 
-  result = clock_gettime(CLOCK_MONOTONIC, &endtime);
-  assert(result == 0);
-  int64_t ns = endtime.tv_nsec;
-  ns -= starttime.tv_nsec;
-  double seconds = static_cast<double>(ns) * 1e-9;
-  seconds += endtime.tv_sec - starttime.tv_sec;
+  double seconds = secondsBetween(starttime, monotonicNow());
+#if PERF_COUNTERS
+  stopPerfBatch();
+#endif
 
   double timePerMillionEdges = seconds * static_cast<double>(1000000);
   timePerMillionEdges /= static_cast<double>(cntEdges) * static_cast<double>(numRounds);
@@ -357,11 +587,20 @@ WHEN_TEST({
 #if TEST_CONVERGENCE
   printConvergenceData(nodes, cntNodes, &globaldata, numRounds);
 #elif VERBOSE
-  printVerboseOutput(nodes, cntNodes, numRounds, &globaldata,
-                     seconds, timePerMillionEdges, initialConvergenceData);
+  printVerboseOutput(nodes, cntNodes, cntEdges, numRounds, &globaldata,
+                     seconds, timePerMillionEdges, initialConvergenceData,
+                     startupTimes, breakEvenRounds(startupTimes, timePerMillionEdges,
+                                                   cntEdges));
 #else
   printCompactOutput(inputEdgeFile, nodes, cntNodes, cntEdges, numRounds, &globaldata,
-                     seconds, timePerMillionEdges, initialConvergenceData);
+                     seconds, timePerMillionEdges, initialConvergenceData,
+                     startupTimes, breakEvenRounds(startupTimes, timePerMillionEdges,
+                                                   cntEdges));
+#endif
+
+#if PERF_COUNTERS
+  printPerfHeader();
+  printPerfBatch(numRounds);
 #endif
 
   cleanup_scheduling(nodes, cntNodes, &scheddata);
@@ -376,29 +615,45 @@ int main_run_to_convergence(int argc, char *argv[]) {
   vid_t cntEdges;
   char * inputEdgeFile;
   char * vertexMetaDataFile = NULL;
+  char * checkpointFile = NULL;
   double convergenceCoefficient;
-  int result = 0;
 
   const int numRounds = 5000000;  // cutoff round number, should never be hit
   const double cutoffTime = 50400.0;  // stop after this many seconds
 
-  // on 48 cores, this means a check about every ~10s on the maximum input size
-  const int roundsBetweenConvergenceChecks = 250;
+  // with fixed intervals, CONVERGENCE_CHECK_INTERVAL = 250 means a check
+  // about every ~10s on the maximum input size on 48 cores
+#if ADAPTIVE_CONVERGENCE_CHECKS
+  int roundsBetweenConvergenceChecks = INITIAL_CONVERGENCE_CHECK_INTERVAL;
+#else
+  int roundsBetweenConvergenceChecks = CONVERGENCE_CHECK_INTERVAL;
+#endif
+
+WHEN_TEST({
+  test_convergence_check_interval();
+})
 
 #if VERTEX_META_DATA
-  if (argc != 4) {
-    cerr << "\nERROR: Expected 3 arguments, received " << argc-1 << '\n';
+  if (argc != 4 && argc != 5) {
+    cerr << "\nERROR: Expected 3 or 4 arguments, received " << argc-1 << '\n';
     cerr << ("Usage: ./compute <convergence_coefficient> "
-             "<input_edges> <vertex_meta_data>") << endl;
+             "<input_edges> <vertex_meta_data> [<checkpoint_file>]") << endl;
     return 1;
   }
   vertexMetaDataFile = argv[3];
+  if (argc == 5) {
+    checkpointFile = argv[4];
+  }
 #else
-  if (argc != 3) {
-    cerr << "\nERROR: Expected 2 arguments, received " << argc-1 << '\n';
-    cerr << "Usage: ./compute <convergence_coefficient> <input_edges>" << endl;
+  if (argc != 3 && argc != 4) {
+    cerr << "\nERROR: Expected 2 or 3 arguments, received " << argc-1 << '\n';
+    cerr << ("Usage: ./compute <convergence_coefficient> "
+             "<input_edges> [<checkpoint_file>]") << endl;
     return 1;
   }
+  if (argc == 4) {
+    checkpointFile = argv[3];
+  }
 #endif
   inputEdgeFile = argv[2];
 
@@ -409,54 +664,112 @@ int main_run_to_convergence(int argc, char *argv[]) {
     return 1;
   }
 
+  if ((checkpointFile != NULL) && !CHECKPOINT_SUPPORTED) {
+    cerr << "\nERROR: Checkpoints are not supported with TEST_CONVERGENCE "
+            "or PRINT_EDGE_LENGTH_HISTOGRAM." << endl;
+    return 1;
+  }
+
   scheddata_t scheddata;
   global_t globaldata;
+  checkpointHeader_t checkpoint;
+  startupTimes_t startupTimes;
 
-  prepareTestRun(inputEdgeFile, vertexMetaDataFile, numRounds, &nodes, &cntNodes,
-                 &cntEdges, &scheddata, &globaldata);
+  //  every batch starts again from round 0, so per-round global data
+  //  only has to cover one batch (plus one round for rounding to even)
+  const bool restored = prepareTestRun(inputEdgeFile, vertexMetaDataFile,
+                                       CONVERGENCE_CHECK_INTERVAL + 1,
+                                       &nodes, &cntNodes, &cntEdges, &scheddata,
+                                       &globaldata, &startupTimes,
+                                       checkpointFile, &checkpoint);
 
   /////////////////////////////////////////////////////////////////////
   ///                     RUNNING THE EXPERIMENT                    ///
   /////////////////////////////////////////////////////////////////////
 
   // calculate the initial convergence data, and the final convergence number
-  // that signals the end of the experiment
-  double currentConvergence = getInitialConvergenceData(nodes, cntNodes, &globaldata);
-  const double cutoffConvergence = currentConvergence * convergenceCoefficient;
+  // that signals the end of the experiment; a restored run keeps the
+  // initial convergence data and progress of the run that wrote the checkpoint
   int roundsExecuted = 0;
   double totalSeconds = 0.0;
+  double initialConvergence;
+  double currentConvergence;
+  if (restored) {
+    roundsExecuted = static_cast<int>(checkpoint.roundsExecuted);
+    totalSeconds = checkpoint.totalSeconds;
+    initialConvergence = checkpoint.initialConvergence;
+    currentConvergence = getConvergenceData(nodes, cntNodes, &globaldata,
+                                            roundsExecuted);
+  } else {
+    initialConvergence = getInitialConvergenceData(nodes, cntNodes, &globaldata);
+    currentConvergence = initialConvergence;
+  }
+  const double cutoffConvergence = initialConvergence * convergenceCoefficient;
+  double lastCheckpointSeconds = totalSeconds;
+  pid_t checkpointInFlight = 0;
 
   printConvergenceExperimentHeader(inputEdgeFile, nodes, cntNodes, cntEdges,
-                                   currentConvergence, convergenceCoefficient,
+                                   initialConvergence, convergenceCoefficient,
                                    roundsBetweenConvergenceChecks);
+  if (restored) {
+    printConvergenceExperimentData(roundsExecuted, totalSeconds, currentConvergence);
+  }
+#if PERF_COUNTERS
+  printPerfHeader();
+#endif
 
-  while (currentConvergence > cutoffConvergence) {
-    struct timespec starttime, endtime;
-    result = clock_gettime(CLOCK_MONOTONIC, &starttime);
-    assert(result == 0);
+  while ((currentConvergence > cutoffConvergence)
+         && (roundsExecuted < numRounds) && (totalSeconds < cutoffTime)) {
+    //  opening and closing the counters is not part of the batch's time
+  #if PERF_COUNTERS
+    startPerfBatch();
+  #endif
+    struct timespec lapStart = monotonicNow();
+
+  #if FUSED_CONVERGENCE
+    startFusedConvergence(&globaldata, roundsBetweenConvergenceChecks - 1);
+  #endif
 
     execute_rounds(roundsBetweenConvergenceChecks,
                    nodes, cntNodes, &scheddata, &globaldata);
 
-    result = clock_gettime(CLOCK_MONOTONIC, &endtime);
-    assert(result == 0);
-    int64_t ns = endtime.tv_nsec;
-    ns -= starttime.tv_nsec;
-    double seconds = static_cast<double>(ns) * 1e-9;
-    seconds += endtime.tv_sec - starttime.tv_sec;
+    const double seconds = lapSeconds(&lapStart);
     totalSeconds += seconds;
+  #if PERF_COUNTERS
+    stopPerfBatch();
+    lapStart = monotonicNow();
+  #endif
 
     roundsExecuted += roundsBetweenConvergenceChecks;
 
+    // the time spent checking is not part of totalSeconds
+    const double lastConvergence = currentConvergence;
+  #if FUSED_CONVERGENCE
+    currentConvergence = finishFusedConvergence(cntNodes, &globaldata);
+  #else
     currentConvergence = getConvergenceData(nodes, cntNodes, &globaldata,
                                             roundsExecuted);
+  #endif
+    const double checkSeconds = lapSeconds(&lapStart);
+
     printConvergenceExperimentData(roundsExecuted, totalSeconds,
                                    currentConvergence);
+  #if PERF_COUNTERS
+    printPerfBatch(roundsBetweenConvergenceChecks);
+  #endif
 
-    // ensure that we are making progress toward convergence, and not just spinning
-    if ((roundsExecuted >= numRounds) || (totalSeconds >= cutoffTime)) {
-      // we've run out of either time or iterations, stop the computation
-      break;
+    roundsBetweenConvergenceChecks =
+      nextConvergenceCheckInterval(roundsBetweenConvergenceChecks, seconds,
+                                   checkSeconds, lastConvergence,
+                                   currentConvergence, cutoffConvergence,
+                                   numRounds - roundsExecuted);
+
+    if ((checkpointFile != NULL)
+        && (totalSeconds - lastCheckpointSeconds >= CHECKPOINT_INTERVAL)
+        && startCheckpoint(checkpointFile, nodes, cntNodes, cntEdges, &globaldata,
+                           roundsExecuted, totalSeconds, initialConvergence,
+                           &checkpointInFlight)) {
+      lastCheckpointSeconds = totalSeconds;
     }
   }
 
@@ -464,6 +777,10 @@ int main_run_to_convergence(int argc, char *argv[]) {
   ///                     END OF THE EXPERIMENT                     ///
   /////////////////////////////////////////////////////////////////////
 
+  if (checkpointFile != NULL) {
+    finishCheckpoint(checkpointFile, &checkpointInFlight);
+  }
+
   cleanup_scheduling(nodes, cntNodes, &scheddata);
 
   return 0;
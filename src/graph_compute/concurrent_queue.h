@@ -1,6 +1,7 @@
 #ifndef CONCURRENT_QUEUE_H_
 #define CONCURRENT_QUEUE_H_
 
+#include <cstdint>
 #include <iostream>
 #include "../libgraphio/libgraphio.h"
 
@@ -59,4 +60,88 @@ inline vid_t mrmw_queue_t::pop() {
   }
 }
 
+//  A Chase-Lev work-stealing deque over a fixed ring buffer.  Only its
+//  owner may push and take, at the bottom, so it runs its own work LIFO;
+//  any other worker may steal from the top, i.e., the oldest work first.
+//  Neither side takes a lock: take and steal only race for the last
+//  value, which a compare-and-swap on top settles.  The memory orders
+//  follow Le et al., "Correct and Efficient Work-Stealing for Weak
+//  Memory Models" (PPoPP 2013).
+struct ws_deque_t {
+  volatile vid_t * const data;
+  const vid_t sentinel;
+  const int64_t mask;
+  //  thieves write top and the owner writes bottom, so keep them on
+  //  different cache lines; new does not honour this alignment before
+  //  C++17, so allocate deques with allocatePadded and placement new
+  volatile int64_t top __attribute__((aligned(CACHE_LINE_SIZE)));
+  volatile int64_t bottom __attribute__((aligned(CACHE_LINE_SIZE)));
+  ws_deque_t(volatile vid_t * const _data, size_t _numBits,
+             const vid_t _sentinel = static_cast<vid_t>(-1)) :
+             data(_data), sentinel(_sentinel),
+             mask((static_cast<int64_t>(1) << _numBits) - 1), top(0), bottom(0) { }
+  // assumes that it is not possible to overflow
+  void push(const vid_t value);  //  owner only
+  void push(const vid_t start, const vid_t end);  //  owner only, push range [start,end)
+  vid_t take();  //  owner only, returns sentinel iff empty
+  vid_t steal();  //  returns sentinel if empty or another take or steal won
+};
+typedef struct ws_deque_t ws_deque_t;
+
+inline void ws_deque_t::push(const vid_t value) {
+  const int64_t b = __atomic_load_n(&bottom, __ATOMIC_RELAXED);
+  data[b & mask] = value;
+  __atomic_store_n(&bottom, b + 1, __ATOMIC_RELEASE);
+}
+
+//  publishes the whole range with a single store to bottom
+inline void ws_deque_t::push(const vid_t start, const vid_t end) {
+  if (end <= start) {
+    return;
+  }
+  const int64_t b = __atomic_load_n(&bottom, __ATOMIC_RELAXED);
+  for (vid_t i = start; i < end; i++) {
+    data[(b + (i - start)) & mask] = i;
+  }
+  __atomic_store_n(&bottom, b + (end - start), __ATOMIC_RELEASE);
+}
+
+inline vid_t ws_deque_t::take() {
+  const int64_t b = __atomic_load_n(&bottom, __ATOMIC_RELAXED) - 1;
+  __atomic_store_n(&bottom, b, __ATOMIC_RELAXED);
+  //  thieves must see the smaller bottom before we read top
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  int64_t t = __atomic_load_n(&top, __ATOMIC_RELAXED);
+  if (t > b) {
+    //  it was empty
+    __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+    return sentinel;
+  }
+  vid_t value = data[b & mask];
+  if (t == b) {
+    //  the last value, which a thief may be stealing right now
+    if (!__atomic_compare_exchange_n(&top, &t, t + 1, false,
+                                     __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+      value = sentinel;
+    }
+    __atomic_store_n(&bottom, b + 1, __ATOMIC_RELAXED);
+  }
+  return value;
+}
+
+inline vid_t ws_deque_t::steal() {
+  int64_t t = __atomic_load_n(&top, __ATOMIC_ACQUIRE);
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+  const int64_t b = __atomic_load_n(&bottom, __ATOMIC_ACQUIRE);
+  if (t >= b) {
+    return sentinel;
+  }
+  const vid_t value = data[t & mask];
+  if (!__atomic_compare_exchange_n(&top, &t, t + 1, false,
+                                   __ATOMIC_SEQ_CST, __ATOMIC_RELAXED)) {
+    return sentinel;
+  }
+  return value;
+}
+
 #endif  // CONCURRENT_QUEUE_H_
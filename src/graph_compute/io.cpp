@@ -1,6 +1,7 @@
 #include "./io.h"
 #include <string>
 #include <algorithm>
+#include "./memory_accounting.h"
 
 class ComputeEdgeListBuilder : public EdgeListBuilder {
  private:
@@ -41,6 +42,7 @@ class ComputeEdgeListBuilder : public EdgeListBuilder {
     } else {
       this->nodes = *(this->outNodes) = new vertex_t[cntNodes]();
     }
+    trackAllocation("nodes", this->nodes, sizeof(vertex_t) * cntNodes);
   }
 
   void set_total_edge_count(vid_t totalEdges) {
@@ -53,6 +55,7 @@ class ComputeEdgeListBuilder : public EdgeListBuilder {
     } else {
       this->edges = *(this->outEdges) = new vid_t[totalEdges]();
     }
+    trackAllocation("edges", this->edges, sizeof(vid_t) * totalEdges);
   }
 
   void set_first_edge_of_node(vid_t nodeid, vid_t firstEdgeIndex) {
@@ -140,6 +143,8 @@ void makeSimpleAndUndirected(vertex_t * nodes,
   } else {
     edges = new (std::nothrow) vid_t[cntEdges]();
   }
+  forgetAllocation(oldEdges);
+  trackAllocation("edges", edges, sizeof(vid_t) * cntEdges);
   for (vid_t v = 0; v < cntNodes; v++) {
     for (vid_t edge = 0; edge < nodes[v].cntEdges; edge++) {
       if (nodes[v].edges[edge] != v) {
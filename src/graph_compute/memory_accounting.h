@@ -0,0 +1,174 @@
+#ifndef MEMORY_ACCOUNTING_H_
+#define MEMORY_ACCOUNTING_H_
+
+#include <unistd.h>
+#include <sys/resource.h>
+#include <sys/syscall.h>
+#include <cstdint>
+#include <cassert>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include "./common.h"
+
+using namespace std;
+
+//  the most allocations the registry can hold at once
+#ifndef MAX_TRACKED_ALLOCATIONS
+  #define MAX_TRACKED_ALLOCATIONS 64
+#endif
+
+//  pages per allocation whose NUMA node is looked up for the report
+#ifndef NUMA_SAMPLE_PAGES
+  #define NUMA_SAMPLE_PAGES 64
+#endif
+
+static const int MAX_NUMA_NODES = 64;
+
+struct trackedAllocation_t {
+  const char * name;
+  const void * address;
+  size_t bytes;
+};
+typedef struct trackedAllocation_t trackedAllocation_t;
+
+struct allocationRegistry_t {
+  trackedAllocation_t allocations[MAX_TRACKED_ALLOCATIONS];
+  int cntAllocations;
+};
+typedef struct allocationRegistry_t allocationRegistry_t;
+
+//  not static, so that io.cpp and compute.cpp share one registry
+inline allocationRegistry_t * allocationRegistry() {
+  static allocationRegistry_t registry;
+  return &registry;
+}
+
+//  Records one of the large, long-lived allocations (the graph and the
+//  scheduler's metadata) for the memory report.  The registry is not
+//  synchronized, so only call this from serial code.
+static inline void trackAllocation(const char * const name, const void * const address,
+                                   const size_t bytes) {
+  allocationRegistry_t * registry = allocationRegistry();
+  assert(registry->cntAllocations < MAX_TRACKED_ALLOCATIONS);
+  trackedAllocation_t * allocation = &registry->allocations[registry->cntAllocations++];
+  allocation->name = name;
+  allocation->address = address;
+  allocation->bytes = bytes;
+}
+
+//  For allocations that are freed before the report is printed
+static inline void forgetAllocation(const void * const address) {
+  allocationRegistry_t * registry = allocationRegistry();
+  for (int i = 0; i < registry->cntAllocations; i++) {
+    if (registry->allocations[i].address == address) {
+      std::copy(&registry->allocations[i + 1],
+                &registry->allocations[registry->cntAllocations],
+                &registry->allocations[i]);
+      registry->cntAllocations--;
+      return;
+    }
+  }
+}
+
+static inline size_t trackedBytes() {
+  const allocationRegistry_t * registry = allocationRegistry();
+  size_t total = 0;
+  for (int i = 0; i < registry->cntAllocations; i++) {
+    total += registry->allocations[i].bytes;
+  }
+  return total;
+}
+
+//  The largest resident set size the process has had so far, in KiB
+static inline int64_t peakResidentKiB() {
+  struct rusage usage;
+  int result = getrusage(RUSAGE_SELF, &usage);
+  assert(result == 0);
+  return static_cast<int64_t>(usage.ru_maxrss);
+}
+
+//  Looks up the NUMA node of up to NUMA_SAMPLE_PAGES evenly spaced pages
+//  of the allocation with move_pages (which only queries when no target
+//  nodes are given) and counts them in pagesPerNode.  Returns the number
+//  of sampled pages that are resident, or -1 if the kernel cannot tell.
+static inline int sampleNumaNodes(const trackedAllocation_t& allocation,
+                                  int (&pagesPerNode)[MAX_NUMA_NODES]) {
+  std::fill(pagesPerNode, pagesPerNode + MAX_NUMA_NODES, 0);
+  if (allocation.bytes == 0) {
+    return 0;
+  }
+  const uintptr_t pageSize = static_cast<uintptr_t>(sysconf(_SC_PAGESIZE));
+  const uintptr_t start = reinterpret_cast<uintptr_t>(allocation.address);
+  const uintptr_t firstPage = start & ~(pageSize - 1);
+  const uintptr_t lastPage = (start + allocation.bytes - 1) & ~(pageSize - 1);
+  const size_t cntPages = (lastPage - firstPage) / pageSize + 1;
+  const size_t maxSamples = NUMA_SAMPLE_PAGES;
+  const int cntSamples = static_cast<int>(std::min(cntPages, maxSamples));
+  void * pages[NUMA_SAMPLE_PAGES];
+  int status[NUMA_SAMPLE_PAGES];
+  for (int i = 0; i < cntSamples; i++) {
+    const size_t page = cntPages * i / cntSamples;
+    pages[i] = reinterpret_cast<void *>(firstPage + page * pageSize);
+  }
+  if (syscall(SYS_move_pages, 0, cntSamples, pages, NULL, status, 0) != 0) {
+    return -1;
+  }
+  int cntResident = 0;
+  for (int i = 0; i < cntSamples; i++) {
+    //  negative values are errors, e.g., -ENOENT for a page never touched
+    if ((status[i] >= 0) && (status[i] < MAX_NUMA_NODES)) {
+      pagesPerNode[status[i]]++;
+      cntResident++;
+    }
+  }
+  return cntResident;
+}
+
+static inline void printBytes(const char * const name, const size_t bytes,
+                              const vid_t cntNodes, const vid_t cntEdges) {
+  cout << "  " << name << ": " << bytes << " bytes ("
+       << setprecision(4) << static_cast<double>(bytes) / std::max(cntNodes, vid_t(1))
+       << " per vertex, "
+       << setprecision(4) << static_cast<double>(bytes) / std::max(cntEdges, vid_t(1))
+       << " per edge)";
+}
+
+//  Prints every tracked allocation with its size per vertex and per edge
+//  and the NUMA nodes its pages are on, then the totals and the peak RSS.
+//  schedBytes is the part of the vertex array taken by sched_t, which
+//  holds the per-vertex scheduler data (e.g., D1_LOCKS' rwlocks).
+static inline void printMemoryUsage(const vid_t cntNodes, const vid_t cntEdges,
+                                    const size_t schedBytes) {
+  const allocationRegistry_t * registry = allocationRegistry();
+  cout << "Memory (tracked allocations):\n";
+  for (int i = 0; i < registry->cntAllocations; i++) {
+    const trackedAllocation_t& allocation = registry->allocations[i];
+    printBytes(allocation.name, allocation.bytes, cntNodes, cntEdges);
+    int pagesPerNode[MAX_NUMA_NODES];
+    const int cntResident = sampleNumaNodes(allocation, pagesPerNode);
+    if (cntResident < 0) {
+      cout << ", NUMA nodes unknown\n";
+      continue;
+    } else if (cntResident == 0) {
+      cout << ", not resident\n";
+      continue;
+    }
+    cout << ", NUMA nodes:";
+    for (int node = 0; node < MAX_NUMA_NODES; node++) {
+      if (pagesPerNode[node] > 0) {
+        cout << ' ' << node << " (" << (100 * pagesPerNode[node] / cntResident) << "%)";
+      }
+    }
+    cout << '\n';
+  }
+  if (schedBytes > 0) {
+    printBytes("sched_t within nodes", schedBytes, cntNodes, cntEdges);
+    cout << '\n';
+  }
+  printBytes("Total tracked", trackedBytes(), cntNodes, cntEdges);
+  cout << '\n';
+  cout << "Peak RSS: " << peakResidentKiB() << " KiB\n";
+}
+
+#endif  // MEMORY_ACCOUNTING_H_
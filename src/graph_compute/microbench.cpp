@@ -0,0 +1,531 @@
+//  Microbenchmarks for the primitives on the hot paths of the schedulers
+//  and apps, each measured at 1, 2, 4, ... up to the requested number of
+//  pthreads.  Build it with the same variables as compute, e.g.
+//    make microbench D1_NUMA=1 PAGERANK=1 PARALLEL=1
+//  and run it as
+//    ./microbench [max_threads] [log2_vertices] [average_degree]
+//  Every measurement is printed as one line:
+//    MICROBENCH, <benchmark>, <threads>, <operations>, <unit>, <seconds>,
+//    <million operations per second>
+
+#include <unistd.h>
+#include <pthread.h>
+#include <cstdio>
+#include <cstdlib>
+#include <cassert>
+#include <cmath>
+#include <string>
+#include <algorithm>
+#include <iostream>
+#include <iomanip>
+#include <vector>
+
+using namespace std;
+
+#include "./common.h"
+#include "./concurrent_queue.h"
+#include "./numa_init.h"
+#include "./topology.h"
+#include "./reduction.h"
+#include "./timing.h"
+
+WHEN_TEST(
+  volatile uint64_t roundUpdateCount = 0;
+)
+
+//  A sense-reversing spin barrier, spinning on a shared flag like the
+//  phase barrier of D1_NUMA
+struct spinBarrier_t {
+  volatile int remaining;
+  volatile int generation;
+  int cntThreads;
+  explicit spinBarrier_t(const int _cntThreads) :
+    remaining(_cntThreads), generation(0), cntThreads(_cntThreads) { }
+  void wait();
+};
+typedef struct spinBarrier_t spinBarrier_t;
+
+inline void spinBarrier_t::wait() {
+  const int myGeneration = generation;
+  if (__sync_sub_and_fetch(&remaining, 1) == 0) {
+    remaining = cntThreads;
+    __sync_synchronize();
+    generation = myGeneration + 1;
+  } else {
+    while (generation == myGeneration) {}
+  }
+}
+
+//  What every benchmark thread gets
+struct benchThread_t {
+  int threadID;
+  int cntThreads;
+  spinBarrier_t * barrier;
+  void * shared;  //  the benchmark's own state
+  double seconds;  //  set by thread 0: the time between the start and end barriers
+};
+typedef struct benchThread_t benchThread_t;
+
+//  1, 2, 4, ... and finally maxThreads
+static inline int nextThreadCount(const int cntThreads, const int maxThreads) {
+  if (cntThreads == maxThreads) {
+    return maxThreads + 1;
+  }
+  return std::min(2*cntThreads, maxThreads);
+}
+
+//  Runs body on cntThreads pthreads; body times itself with startTiming
+//  and stopTiming, which include a barrier each
+static inline double runThreads(const int cntThreads, void * const shared,
+                                void * (*body)(void *)) {
+  spinBarrier_t barrier(cntThreads);
+  vector<benchThread_t> threads(cntThreads);
+  vector<pthread_t> workers(cntThreads);
+  for (int i = 0; i < cntThreads; i++) {
+    threads[i].threadID = i;
+    threads[i].cntThreads = cntThreads;
+    threads[i].barrier = &barrier;
+    threads[i].shared = shared;
+    threads[i].seconds = 0.0;
+    int result = pthread_create(&workers[i], NULL, body, &threads[i]);
+    assert(result == 0);
+  }
+  for (int i = 0; i < cntThreads; i++) {
+    int result = pthread_join(workers[i], NULL);
+    assert(result == 0);
+  }
+  return threads[0].seconds;
+}
+
+static inline struct timespec startTiming(benchThread_t * const thread) {
+  bindThreadToWorkerCpu(thread->threadID);
+  setWorkerNumber(thread->threadID);
+  thread->barrier->wait();
+  return monotonicNow();
+}
+
+static inline void stopTiming(benchThread_t * const thread,
+                              const struct timespec& start) {
+  thread->barrier->wait();
+  if (thread->threadID == 0) {
+    thread->seconds = secondsBetween(start, monotonicNow());
+  }
+}
+
+static inline void printHeader() {
+  cout << "MICROBENCH, benchmark, threads, operations, unit, seconds, "
+       << "million_per_second" << endl;
+}
+
+static inline void printResult(const string& benchmark, const int cntThreads,
+                               const uint64_t operations, const string& unit,
+                               const double seconds) {
+  cout << "MICROBENCH, " << benchmark << ", " << cntThreads << ", "
+       << operations << ", " << unit << ", " << setprecision(6) << seconds << ", "
+       << setprecision(6) << (operations / seconds / 1e6) << endl;
+}
+
+/////////////////////////////////////////////////////////////////////
+///                   mrmw_queue_t push and pop                   ///
+/////////////////////////////////////////////////////////////////////
+
+static const int QUEUE_BITS = 16;
+static const uint64_t QUEUE_OPERATIONS_PER_THREAD = 1 << 18;
+
+struct queueBench_t {
+  mrmw_queue_t * queue;
+  volatile uint64_t failedPops;
+};
+typedef struct queueBench_t queueBench_t;
+
+//  Every thread pushes a value and pops one, retrying pops that were
+//  turned away by the lock, so all threads contend for the same queue
+static inline void * queueBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  queueBench_t * bench = static_cast<queueBench_t *>(thread->shared);
+  uint64_t failedPops = 0;
+  const struct timespec start = startTiming(thread);
+  for (uint64_t i = 0; i < QUEUE_OPERATIONS_PER_THREAD; i++) {
+    bench->queue->push(static_cast<vid_t>(i));
+    while (bench->queue->pop() == bench->queue->sentinel) {
+      failedPops++;
+    }
+  }
+  stopTiming(thread, start);
+  __sync_fetch_and_add(&bench->failedPops, failedPops);
+  return NULL;
+}
+
+static inline void benchmarkQueue(const int cntThreads) {
+  numaInit_t numaInit(cntThreads, CHUNK_BITS, false);
+  volatile vid_t * data = static_cast<vid_t *>(numaCalloc(numaInit,
+      sizeof(vid_t), 1 << QUEUE_BITS));
+  mrmw_queue_t queue(data, QUEUE_BITS);
+  queueBench_t bench;
+  bench.queue = &queue;
+  bench.failedPops = 0;
+  const double seconds = runThreads(cntThreads, &bench, queueBody);
+  const uint64_t operations = QUEUE_OPERATIONS_PER_THREAD*cntThreads;
+  printResult("queue_push_pop", cntThreads, operations, "push_pop", seconds);
+  printResult("queue_failed_pops", cntThreads, bench.failedPops, "pop", seconds);
+  free(const_cast<vid_t *>(data));
+}
+
+/////////////////////////////////////////////////////////////////////
+///                   ws_deque_t take and steal                   ///
+/////////////////////////////////////////////////////////////////////
+
+static const int DEQUE_BATCH = 1 << 10;
+static const int DEQUE_BATCHES = 1 << 8;
+
+struct dequeBench_t {
+  ws_deque_t * deque;
+  volatile uint64_t stolen;
+  volatile uint64_t failedSteals;
+  volatile int done;
+};
+typedef struct dequeBench_t dequeBench_t;
+
+//  Thread 0 owns the deque, like a D1_NUMA worker: it pushes a batch of
+//  values at once and takes them back one by one, while all other threads
+//  keep stealing until the owner is done
+static inline void * dequeBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  dequeBench_t * bench = static_cast<dequeBench_t *>(thread->shared);
+  uint64_t stolen = 0;
+  uint64_t failedSteals = 0;
+  const struct timespec start = startTiming(thread);
+  if (thread->threadID == 0) {
+    for (int batch = 0; batch < DEQUE_BATCHES; batch++) {
+      bench->deque->push(0, DEQUE_BATCH);
+      while (bench->deque->take() != bench->deque->sentinel) {}
+    }
+    bench->done = 1;
+  } else {
+    while (!bench->done) {
+      if (bench->deque->steal() == bench->deque->sentinel) {
+        failedSteals++;
+      } else {
+        stolen++;
+      }
+    }
+  }
+  stopTiming(thread, start);
+  __sync_fetch_and_add(&bench->stolen, stolen);
+  __sync_fetch_and_add(&bench->failedSteals, failedSteals);
+  return NULL;
+}
+
+static inline void benchmarkDeque(const int cntThreads) {
+  numaInit_t numaInit(cntThreads, CHUNK_BITS, false);
+  volatile vid_t * data = static_cast<vid_t *>(numaCalloc(numaInit,
+      sizeof(vid_t), 1 << QUEUE_BITS));
+  ws_deque_t deque(data, QUEUE_BITS);
+  dequeBench_t bench;
+  bench.deque = &deque;
+  bench.stolen = 0;
+  bench.failedSteals = 0;
+  bench.done = 0;
+  const double seconds = runThreads(cntThreads, &bench, dequeBody);
+  const uint64_t operations = static_cast<uint64_t>(DEQUE_BATCH)*DEQUE_BATCHES;
+  printResult("deque_push_take_steal", cntThreads, operations, "value", seconds);
+  printResult("deque_stolen", cntThreads, bench.stolen, "value", seconds);
+  printResult("deque_failed_steals", cntThreads, bench.failedSteals, "steal", seconds);
+  free(const_cast<vid_t *>(data));
+}
+
+/////////////////////////////////////////////////////////////////////
+///                         spin barrier                          ///
+/////////////////////////////////////////////////////////////////////
+
+static const uint64_t BARRIER_EPISODES = 1 << 14;
+
+static inline void * barrierBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  const struct timespec start = startTiming(thread);
+  for (uint64_t i = 0; i < BARRIER_EPISODES; i++) {
+    thread->barrier->wait();
+  }
+  stopTiming(thread, start);
+  return NULL;
+}
+
+static inline void benchmarkBarrier(const int cntThreads) {
+  const double seconds = runThreads(cntThreads, NULL, barrierBody);
+  printResult("spin_barrier", cntThreads, BARRIER_EPISODES, "barrier", seconds);
+}
+
+/////////////////////////////////////////////////////////////////////
+///                     numaCalloc bandwidth                      ///
+/////////////////////////////////////////////////////////////////////
+
+static const size_t CALLOC_BYTES = static_cast<size_t>(1) << 28;
+
+static inline void benchmarkNumaCalloc(const int cntThreads) {
+  //  fresh pages every time, so the first touch is part of the measurement
+  numaInit_t numaInit(cntThreads, CHUNK_BITS, true);
+  const struct timespec start = monotonicNow();
+  void * data = numaCalloc(numaInit, 1, CALLOC_BYTES);
+  const double seconds = secondsBetween(start, monotonicNow());
+  printResult("numa_calloc", cntThreads, CALLOC_BYTES, "byte", seconds);
+  free(data);
+}
+
+/////////////////////////////////////////////////////////////////////
+///               update() on synthetic graphs                    ///
+/////////////////////////////////////////////////////////////////////
+
+static const int UPDATE_ROUNDS = 4;
+
+static inline uint64_t xorshift(uint64_t * const state) {
+  uint64_t x = *state;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  *state = x;
+  return x;
+}
+
+//  A graph whose vertices all have averageDegree neighbours close by in
+//  vertex order ("local", like a well reordered mesh), or whose degrees
+//  follow a power law with exponent 2.5 and the same mean and whose
+//  neighbours are uniformly random ("power_law")
+static inline vertex_t * syntheticGraph(const vid_t cntNodes, const vid_t averageDegree,
+                                        const bool powerLaw, vid_t ** const outEdges,
+                                        vid_t * const outCntEdges) {
+  vertex_t * nodes = new (std::nothrow) vertex_t[cntNodes]();
+  assert(nodes != NULL);
+  vector<vid_t> degrees(cntNodes);
+  uint64_t state = 0x9E3779B97F4A7C15ULL;
+  vid_t cntEdges = 0;
+  const double minDegree = std::max(1.0, averageDegree / 3.0);
+  for (vid_t i = 0; i < cntNodes; i++) {
+    if (powerLaw) {
+      const double u = (xorshift(&state) >> 11) * (1.0 / 9007199254740992.0);
+      const double degree = minDegree / pow(1.0 - u, 1.0 / 1.5);
+      degrees[i] = static_cast<vid_t>(std::min(degree, cntNodes - 1.0));
+    } else {
+      degrees[i] = std::min(averageDegree, cntNodes - 1);
+    }
+    cntEdges += degrees[i];
+  }
+  vid_t * edges = new (std::nothrow) vid_t[cntEdges];
+  assert(edges != NULL);
+  vid_t edge = 0;
+  for (vid_t i = 0; i < cntNodes; i++) {
+    nodes[i].edges = &edges[edge];
+    nodes[i].cntEdges = degrees[i];
+    for (vid_t j = 0; j < degrees[i]; j++) {
+      vid_t neighbor;
+      if (powerLaw) {
+        neighbor = static_cast<vid_t>(xorshift(&state) % (cntNodes - 1));
+      } else {
+        neighbor = (i + cntNodes - degrees[i]/2 + j) % (cntNodes - 1);
+      }
+      //  skip the vertex itself
+      edges[edge++] = (neighbor >= i) ? neighbor + 1 : neighbor;
+    }
+    std::sort(nodes[i].edges, nodes[i].edges + nodes[i].cntEdges);
+  }
+  *outEdges = edges;
+  *outCntEdges = cntEdges;
+  return nodes;
+}
+
+#if VERTEX_META_DATA
+//  The node file fillInNodeData expects: a header, then "<id> <x> <y> <z>"
+static inline string writeSyntheticNodeFile(const vid_t cntNodes) {
+  char filepath[] = "/tmp/microbench_nodes_XXXXXX";
+  int fd = mkstemp(filepath);
+  assert(fd >= 0);
+  FILE * file = fdopen(fd, "w");
+  assert(file != NULL);
+  fprintf(file, "%" PRIu64 " 0 0 0\n", static_cast<uint64_t>(cntNodes));
+  uint64_t state = 0xD1B54A32D192ED03ULL;
+  for (vid_t i = 0; i < cntNodes; i++) {
+    fprintf(file, "%" PRIu64, static_cast<uint64_t>(i));
+    for (int d = 0; d < DIMENSIONS; d++) {
+      fprintf(file, " %f", (xorshift(&state) % 1000000) / 1000.0);
+    }
+    fprintf(file, "\n");
+  }
+  fclose(file);
+  return string(filepath);
+}
+#endif
+
+struct updateBench_t {
+  vertex_t * nodes;
+  vid_t cntNodes;
+  global_t * globaldata;
+};
+typedef struct updateBench_t updateBench_t;
+
+//  Every thread updates its own contiguous range of vertices, with a
+//  barrier between rounds, like D0_BSP without the Cilk runtime
+static inline void * updateBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  updateBench_t * bench = static_cast<updateBench_t *>(thread->shared);
+  const vid_t start = bench->cntNodes / thread->cntThreads * thread->threadID;
+  const vid_t end = (thread->threadID + 1 == thread->cntThreads) ? bench->cntNodes
+    : bench->cntNodes / thread->cntThreads * (thread->threadID + 1);
+  const struct timespec startTime = startTiming(thread);
+  for (int round = 0; round < UPDATE_ROUNDS; round++) {
+    for (vid_t i = start; i < end; i++) {
+      update(bench->nodes, i, bench->globaldata, round);
+    }
+    thread->barrier->wait();
+  }
+  stopTiming(thread, startTime);
+  return NULL;
+}
+
+static inline void benchmarkUpdate(const int maxThreads, const vid_t cntNodes,
+                                   const vid_t averageDegree, const bool powerLaw) {
+  vid_t * edges;
+  vid_t cntEdges;
+  vertex_t * nodes = syntheticGraph(cntNodes, averageDegree, powerLaw, &edges, &cntEdges);
+#if VERTEX_META_DATA
+  const string nodeFile = writeSyntheticNodeFile(cntNodes);
+  fillInNodeData(nodes, cntNodes, nodeFile);
+  unlink(nodeFile.c_str());
+#else
+  fillInNodeData(nodes, cntNodes);
+#endif
+  global_t globaldata;
+  fillInGlobalData(nodes, cntNodes, &globaldata, UPDATE_ROUNDS);
+
+  const string name = string("update_") + APP_NAME + (powerLaw ? "_power_law" : "_local");
+  updateBench_t bench;
+  bench.nodes = nodes;
+  bench.cntNodes = cntNodes;
+  bench.globaldata = &globaldata;
+  for (int cntThreads = 1; cntThreads <= maxThreads;
+       cntThreads = nextThreadCount(cntThreads, maxThreads)) {
+    const double seconds = runThreads(cntThreads, &bench, updateBody);
+    printResult(name, cntThreads, static_cast<uint64_t>(cntEdges)*UPDATE_ROUNDS,
+                "edge", seconds);
+  }
+  delete[] edges;
+  delete[] nodes;
+}
+
+/////////////////////////////////////////////////////////////////////
+///           interChunkDependency and samePhase                  ///
+/////////////////////////////////////////////////////////////////////
+
+#if D1_CHUNK || D1_NUMA
+
+static const uint64_t DEPENDENCY_CHECKS_PER_THREAD = 1 << 24;
+
+struct dependencyBench_t {
+  vid_t cntNodes;
+#if D1_NUMA
+  chunkdata_t * chunkdata;
+#endif
+  volatile uint64_t checksum;  //  keeps the calls from being optimized away
+};
+typedef struct dependencyBench_t dependencyBench_t;
+
+static inline void * interChunkDependencyBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  dependencyBench_t * bench = static_cast<dependencyBench_t *>(thread->shared);
+  uint64_t state = thread->threadID + 1;
+  uint64_t count = 0;
+  const struct timespec start = startTiming(thread);
+  for (uint64_t i = 0; i < DEPENDENCY_CHECKS_PER_THREAD; i++) {
+    const uint64_t random = xorshift(&state);
+    const vid_t v = static_cast<vid_t>(random % bench->cntNodes);
+    const vid_t w = static_cast<vid_t>((random >> 32) % bench->cntNodes);
+    count += interChunkDependency(v, w);
+  }
+  stopTiming(thread, start);
+  __sync_fetch_and_add(&bench->checksum, count);
+  return NULL;
+}
+
+#if D1_NUMA
+static inline void * samePhaseBody(void * param) {
+  benchThread_t * thread = static_cast<benchThread_t *>(param);
+  dependencyBench_t * bench = static_cast<dependencyBench_t *>(thread->shared);
+  uint64_t state = thread->threadID + 1;
+  uint64_t count = 0;
+  const struct timespec start = startTiming(thread);
+  for (uint64_t i = 0; i < DEPENDENCY_CHECKS_PER_THREAD; i++) {
+    const uint64_t random = xorshift(&state);
+    const vid_t v = static_cast<vid_t>(random % bench->cntNodes);
+    const vid_t w = static_cast<vid_t>((random >> 32) % bench->cntNodes);
+    count += samePhase(v, w, bench->chunkdata);
+  }
+  stopTiming(thread, start);
+  __sync_fetch_and_add(&bench->checksum, count);
+  return NULL;
+}
+#endif
+
+static inline void benchmarkDependencies(const int cntThreads, const vid_t cntNodes) {
+  dependencyBench_t bench;
+  bench.cntNodes = cntNodes;
+  bench.checksum = 0;
+  const uint64_t operations = DEPENDENCY_CHECKS_PER_THREAD*cntThreads;
+  double seconds = runThreads(cntThreads, &bench, interChunkDependencyBody);
+  printResult("inter_chunk_dependency", cntThreads, operations, "check", seconds);
+#if D1_NUMA
+  //  every chunk split in two phases at its midpoint
+  const vid_t cntChunks = (cntNodes + (1 << CHUNK_BITS) - 1) >> CHUNK_BITS;
+  bench.chunkdata = new (std::nothrow) chunkdata_t[cntChunks];
+  assert(bench.chunkdata != NULL);
+  for (vid_t i = 0; i < cntChunks; i++) {
+    bench.chunkdata[i].phaseEndIndex[0] = (i << CHUNK_BITS) + (1 << (CHUNK_BITS - 1));
+    bench.chunkdata[i].phaseEndIndex[1] = (i + 1) << CHUNK_BITS;
+  }
+  seconds = runThreads(cntThreads, &bench, samePhaseBody);
+  printResult("same_phase", cntThreads, operations, "check", seconds);
+  delete[] bench.chunkdata;
+#endif
+}
+
+#endif  // D1_CHUNK || D1_NUMA
+
+int main(int argc, char *argv[]) {
+  int maxThreads = static_cast<int>(sysconf(_SC_NPROCESSORS_ONLN));
+  int logCntNodes = 20;
+  vid_t averageDegree = 16;
+  try {
+    if (argc > 1) {
+      maxThreads = stoi(argv[1]);
+    }
+    if (argc > 2) {
+      logCntNodes = stoi(argv[2]);
+    }
+    if (argc > 3) {
+      averageDegree = static_cast<vid_t>(stoul(argv[3]));
+    }
+  } catch (exception& e) {
+    cerr << "\nERROR: " << e.what() << '\n';
+    cerr << "Usage: ./microbench [max_threads] [log2_vertices] [average_degree]" << endl;
+    return 1;
+  }
+  if ((maxThreads < 1) || (maxThreads > MAX_WORKERS) || (logCntNodes < 1)
+      || (averageDegree < 1)) {
+    cerr << "\nERROR: Expected 1 <= max_threads <= " << MAX_WORKERS
+         << ", log2_vertices >= 1 and average_degree >= 1" << endl;
+    return 1;
+  }
+  const vid_t cntNodes = static_cast<vid_t>(1) << logCntNodes;
+
+  printHeader();
+  for (int cntThreads = 1; cntThreads <= maxThreads;
+       cntThreads = nextThreadCount(cntThreads, maxThreads)) {
+    benchmarkQueue(cntThreads);
+    benchmarkDeque(cntThreads);
+    benchmarkBarrier(cntThreads);
+    benchmarkNumaCalloc(cntThreads);
+  #if D1_CHUNK || D1_NUMA
+    benchmarkDependencies(cntThreads, cntNodes);
+  #endif
+  }
+  benchmarkUpdate(maxThreads, cntNodes, averageDegree, false);
+  benchmarkUpdate(maxThreads, cntNodes, averageDegree, true);
+  return 0;
+}
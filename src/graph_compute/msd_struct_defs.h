@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
 
 #ifndef DIMENSIONS
   #define DIMENSIONS 3
@@ -28,8 +29,12 @@ struct global_t {
   phys_t timeStep;
   phys_t restLength;
 
+  #if FUSED_CONVERGENCE
+    int convergenceRound;  //  updates in this round add to the convergence data
+  #endif
+
   #if TEST_CONVERGENCE
-    phys_t * sumSquareNetForce;
+    worker_rows_t<phys_t> sumSquareNetForce;  //  one column per round
   #endif
 
   #if PRINT_EDGE_LENGTH_HISTOGRAM
@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
 
 using namespace std;
 
@@ -50,40 +51,79 @@ static inline void printPosition(phys_t (&a)[DIMENSIONS]) {
   cout << endl;
 }
 
-static inline void fixExtremalPoints(vertex_t * const nodes,
-                                     const vid_t cntNodes) {
+struct extremalPoints_t {
   phys_t maxPoint[DIMENSIONS];
   vid_t maxOwner[DIMENSIONS];
   phys_t minPoint[DIMENSIONS];
   vid_t minOwner[DIMENSIONS];
+};
+typedef struct extremalPoints_t extremalPoints_t;
+
+//  The extremal points of vertices [start, end); ties go to the lowest index
+static inline extremalPoints_t findExtremalPoints(const vertex_t * const nodes,
+                                                  const vid_t start,
+                                                  const vid_t end) {
+  extremalPoints_t result;
 #if IN_PLACE
-  data_t * node = &nodes[0].data;
+  const data_t * node = &nodes[start].data;
 #else
-  data_t * node = &nodes[0].data[0];
+  const data_t * node = &nodes[start].data[0];
 #endif
   for (int i = 0; i < DIMENSIONS; i++) {
-    maxPoint[i] = node->position[i];
-    maxOwner[i] = 0;
-    minPoint[i] = node->position[i];
-    minOwner[i] = 0;
+    result.maxPoint[i] = node->position[i];
+    result.maxOwner[i] = start;
+    result.minPoint[i] = node->position[i];
+    result.minOwner[i] = start;
   }
-  for (vid_t v = 0; v < cntNodes; v++) {
+  for (vid_t v = start; v < end; v++) {
   #if IN_PLACE
     node = &nodes[v].data;
   #else
     node = &nodes[v].data[0];
   #endif
     for (int i = 0; i < DIMENSIONS; i++) {
-      if (node->position[i] > maxPoint[i]) {
-        maxPoint[i] = node->position[i];
-        maxOwner[i] = v;
+      if (node->position[i] > result.maxPoint[i]) {
+        result.maxPoint[i] = node->position[i];
+        result.maxOwner[i] = v;
       }
-      if (node->position[i] < minPoint[i]) {
-        minPoint[i] = node->position[i];
-        minOwner[i] = v;
+      if (node->position[i] < result.minPoint[i]) {
+        result.minPoint[i] = node->position[i];
+        result.minOwner[i] = v;
       }
     }
   }
+  return result;
+}
+
+//  Merges the extremal points of two consecutive ranges of vertices
+static inline extremalPoints_t mergeExtremalPoints(const extremalPoints_t& earlier,
+                                                   const extremalPoints_t& later) {
+  extremalPoints_t result = earlier;
+  for (int i = 0; i < DIMENSIONS; i++) {
+    if (later.maxPoint[i] > result.maxPoint[i]) {
+      result.maxPoint[i] = later.maxPoint[i];
+      result.maxOwner[i] = later.maxOwner[i];
+    }
+    if (later.minPoint[i] < result.minPoint[i]) {
+      result.minPoint[i] = later.minPoint[i];
+      result.minOwner[i] = later.minOwner[i];
+    }
+  }
+  return result;
+}
+
+static inline void fixExtremalPoints(vertex_t * const nodes,
+                                     const vid_t cntNodes) {
+  extremalPoints_t extremal = parallelReduce<extremalPoints_t>(cntNodes,
+    findExtremalPoints(nodes, 0, 1),
+    [nodes](const vid_t start, const vid_t end) {
+      return findExtremalPoints(nodes, start, end);
+    },
+    mergeExtremalPoints);
+  const phys_t (&maxPoint)[DIMENSIONS] = extremal.maxPoint;
+  const vid_t (&maxOwner)[DIMENSIONS] = extremal.maxOwner;
+  const phys_t (&minPoint)[DIMENSIONS] = extremal.minPoint;
+  const vid_t (&minOwner)[DIMENSIONS] = extremal.minOwner;
   phys_t maxScale = 0.0;
   for (int i = 0; i < DIMENSIONS; i++) {
   #if IN_PLACE
@@ -101,7 +141,7 @@ static inline void fixExtremalPoints(vertex_t * const nodes,
   }
 #if NORMALIZE_TO_UNIT_CUBE
   phys_t inverseScale = 1 / maxScale;
-  for (vid_t i = 0; i < cntNodes; i++) {
+  cilk_for (vid_t i = 0; i < cntNodes; i++) {
     for (int d = 0; d < DIMENSIONS; d++) {
     #if IN_PLACE
       nodes[i].data.position[d]
@@ -117,30 +157,60 @@ static inline void fixExtremalPoints(vertex_t * const nodes,
 #endif
 }
 
+//  Reads the whole file into a new[]-allocated, NUL-terminated buffer
+static inline char * readFileIntoBuffer(const string& filepath, size_t * const outSize) {
+  FILE * file = fopen(filepath.c_str(), "rb");
+  assert(file != NULL);
+  int result = fseek(file, 0, SEEK_END);
+  assert(result == 0);
+  const size_t size = static_cast<size_t>(ftell(file));
+  rewind(file);
+  char * buffer = new (std::nothrow) char[size + 1];
+  assert(buffer != NULL);
+  const size_t bytesRead = fread(buffer, 1, size, file);
+  assert(bytesRead == size);
+  buffer[size] = '\0';
+  fclose(file);
+  *outSize = size;
+  return buffer;
+}
+
+//  The node file holds a header line followed by one line per vertex,
+//  "<id> <x> <y> <z>".  The file is read in one go, the line starts are
+//  found in parallel, and the lines are then parsed in parallel.
 static inline void fillInNodeData(vertex_t * const nodes,
                                   const vid_t cntNodes,
                                   const string filepath) {
-  FILE * nodeInputFile = fopen(filepath.c_str(), "r");
+  size_t size;
+  char * buffer = readFileIntoBuffer(filepath, &size);
   uint64_t tmpCntNodes, g0, g1, g2;
-  int cntItems = fscanf(nodeInputFile, "%" SCNu64 "%" SCNu64 "%" SCNu64 "%" SCNu64 "\n",
+  int cntItems = sscanf(buffer, "%" SCNu64 "%" SCNu64 "%" SCNu64 "%" SCNu64,
     &tmpCntNodes, &g0, &g1, &g2);
   assert(cntItems == 4);
   assert(static_cast<vid_t>(tmpCntNodes) == cntNodes);
-  for (vid_t i = 0; i < cntNodes; i++) {
+
+  size_t cntLines;
+  size_t * lineStarts = parallelFilter(size, [buffer](const size_t i) {
+    return (i > 0) && (buffer[i - 1] == '\n') && (buffer[i] != '\0');
+  }, &cntLines);
+  assert(cntLines >= static_cast<size_t>(cntNodes));
+
+  cilk_for (vid_t i = 0; i < cntNodes; i++) {
   #if IN_PLACE
     nodes[i].data.fixed = false;
   #else
     nodes[i].data[0].fixed = false;
     nodes[i].data[1].fixed = false;
   #endif
-    uint64_t nodeID;
-    cntItems = fscanf(nodeInputFile, "%" SCNu64, &nodeID);
-    assert(cntItems == 1);
+    char * line = &buffer[lineStarts[i]];
+    char * end;
+    uint64_t nodeID = strtoull(line, &end, 10);
+    assert(end != line);
     assert(static_cast<vid_t>(nodeID) == i);
     for (int d = 0; d < DIMENSIONS; d++) {
-      double position;
-      cntItems = fscanf(nodeInputFile, "%lf ", &position);
-      assert(cntItems == 1);
+      line = end;
+      double position = strtod(line, &end);
+      assert(end != line);
     #if IN_PLACE
       nodes[i].data.velocity[d] = 0;
       nodes[i].data.position[d] = static_cast<phys_t>(position);
@@ -152,7 +222,8 @@ static inline void fillInNodeData(vertex_t * const nodes,
     #endif
     }
   }
-  fclose(nodeInputFile);
+  delete[] lineStarts;
+  delete[] buffer;
   fixExtremalPoints(nodes, cntNodes);
 }
 
@@ -179,10 +250,10 @@ static inline void printConvergenceData(const vertex_t * const nodes,
                                         const int numRounds) {
 #if TEST_CONVERGENCE
   phys_t normalizer = sqrt(static_cast<phys_t>(cntNodes)
-    / globaldata->sumSquareNetForce[0]);
+    / globaldata->sumSquareNetForce.sum(0));
   cout << 1.0 << endl;
   for (int i = 1; i < numRounds; i++) {
-    cout << (normalizer*sqrt(globaldata->sumSquareNetForce[i]
+    cout << (normalizer*sqrt(globaldata->sumSquareNetForce.sum(i)
       / static_cast<phys_t>(cntNodes))) << endl;
   }
 #endif
@@ -319,52 +390,77 @@ static inline void getNetForce(const vertex_t * const nodes,
   }
 }
 
+static inline double vertexEnergy(const vertex_t * const nodes,
+                                  const vid_t i,
+                                  const global_t * const globaldata,
+                                  const int round,
+                                  const bool includeSpringEnergy) {
+  const vertex_t& current = nodes[i];
+
+  #if IN_PLACE
+    const data_t& currentData = current.data;
+  #else
+    const data_t& currentData = current.data[round & 1];
+  #endif
+
+  // add the vertex's energy due to velocity: 1/2 * mv^2
+  // since we store inverse mass, we divide by the inverse mass to multiply by mass
+  const phys_t v = static_cast<double>(length(currentData.velocity));
+  double energy = (v * v) / (2 * globaldata->inverseMass);
+
+  if (includeSpringEnergy) {
+    // add the spring energy of all springs between
+    // the current vertex and its neighbors of higher ID number
+    // (to only count once -- there are no self-edges)
+    for (vid_t j = 0; j < current.cntEdges; ++j) {
+      const vid_t neighborId = current.edges[j];
+      if (neighborId > i) {
+        const vertex_t& neighbor = nodes[neighborId];
+
+        #if IN_PLACE
+          const data_t& neighborData = neighbor.data;
+        #else
+          const data_t& neighborData = neighbor.data[round & 1];
+        #endif
+
+        const phys_t springEnergy = springInternalEnergy(currentData.position,
+                                                         neighborData.position,
+                                                         globaldata->restLength,
+                                                         globaldata->springStiffness);
+        energy += static_cast<double>(springEnergy);
+      }
+    }
+  }
+  return energy;
+}
+
 static inline double getConvergenceData(const vertex_t * const nodes,
                                         const vid_t cntNodes,
                                         const global_t * const globaldata,
                                         const int round,
                                         const bool includeSpringEnergy = false) {
-  double totalEnergy = 0.0;
-  for (vid_t i = 0; i < cntNodes; ++i) {
-    const vertex_t& current = nodes[i];
+  return parallelSum<double>(cntNodes,
+    [nodes, globaldata, round, includeSpringEnergy](const vid_t i) {
+      return vertexEnergy(nodes, i, globaldata, round, includeSpringEnergy);
+    });
+}
 
-    #if IN_PLACE
-      const data_t& currentData = current.data;
-    #else
-      const data_t& currentData = current.data[round & 1];
-    #endif
+#if FUSED_CONVERGENCE
+//  The updates of the given round add the kinetic energy of their
+//  new velocity to per-worker sums.  Fixed vertices never move, so this
+//  equals getConvergenceData of the state after that round.
+static inline void startFusedConvergence(global_t * const globaldata,
+                                         const int round) {
+  collectFusedConvergence();
+  globaldata->convergenceRound = round;
+}
 
-    // add the vertex's energy due to velocity: 1/2 * mv^2
-    // since we store inverse mass, we divide by the inverse mass to multiply by mass
-    const phys_t v = static_cast<double>(length(currentData.velocity));
-    totalEnergy += (v * v) / (2 * globaldata->inverseMass);
-
-    if (includeSpringEnergy) {
-      // add the spring energy of all springs between
-      // the current vertex and its neighbors of higher ID number
-      // (to only count once -- there are no self-edges)
-      for (vid_t j = 0; j < current.cntEdges; ++j) {
-        const vid_t neighborId = current.edges[j];
-        if (neighborId > i) {
-          const vertex_t& neighbor = nodes[neighborId];
-
-          #if IN_PLACE
-            const data_t& neighborData = neighbor.data;
-          #else
-            const data_t& neighborData = neighbor.data[round & 1];
-          #endif
-
-          const phys_t springEnergy = springInternalEnergy(currentData.position,
-                                                           neighborData.position,
-                                                           globaldata->restLength,
-                                                           globaldata->springStiffness);
-          totalEnergy += static_cast<double>(springEnergy);
-        }
-      }
-    }
-  }
-  return totalEnergy;
+static inline double finishFusedConvergence(const vid_t cntNodes,
+                                            global_t * const globaldata) {
+  globaldata->convergenceRound = -1;
+  return collectFusedConvergence();
 }
+#endif
 
 static inline double getInitialConvergenceData(const vertex_t * const nodes,
                                                const vid_t cntNodes,
@@ -375,13 +471,13 @@ static inline double getInitialConvergenceData(const vertex_t * const nodes,
 static inline double getForceBasedConvergenceData(const vertex_t * const nodes,
                                                   const vid_t cntNodes,
                                                   const global_t * const globaldata) {
-  phys_t meanSquare = 0.0;
-  for (vid_t v = 0; v < cntNodes; v++) {
-    phys_t acceleration[DIMENSIONS];
-    getNetForce(nodes, v, acceleration, globaldata);
-    phys_t tmpMeanSquare = length(acceleration);
-    meanSquare += tmpMeanSquare*tmpMeanSquare;
-  }
+  const phys_t meanSquare = parallelSum<phys_t>(cntNodes,
+    [nodes, globaldata](const vid_t v) {
+      phys_t acceleration[DIMENSIONS];
+      getNetForce(nodes, v, acceleration, globaldata);
+      phys_t tmpMeanSquare = length(acceleration);
+      return tmpMeanSquare*tmpMeanSquare;
+    });
   return static_cast<double>(sqrt(meanSquare / static_cast<phys_t>(cntNodes)));
 }
 
@@ -393,16 +489,18 @@ static inline void fillInGlobalData(vertex_t * const nodes,
   globaldata->springStiffness = 1.0;
   globaldata->dashpotResistance = 1.0;
   globaldata->inverseMass = 1.0;
+#if FUSED_CONVERGENCE
+  globaldata->convergenceRound = -1;
+#endif
 #if TEST_CONVERGENCE
-  globaldata->sumSquareNetForce = new (std::nothrow) phys_t[numRounds]();
+  globaldata->sumSquareNetForce.init(numRounds);
 #endif
-  phys_t globalRestLength = 0.0;
-  vid_t globalCntEdges = 0;
-  for (vid_t i = 0; i < cntNodes; i++) {
+  //  the edge lengths of every vertex are summed in parallel into its
+  //  restLength, but the vertex sums are added up in vertex order, so
+  //  the global rest length is the same as that of a serial pass
+  cilk_for (vid_t i = 0; i < cntNodes; i++) {
     phys_t restLength = 0.0;
-    vid_t cntEdges = 0;
     for (vid_t edge = 0; edge < nodes[i].cntEdges; edge++) {
-      cntEdges++;
       vid_t neighbor = nodes[i].edges[edge];
     #if IN_PLACE
       restLength += distance(nodes[i].data.position,
@@ -412,26 +510,41 @@ static inline void fillInGlobalData(vertex_t * const nodes,
                              nodes[neighbor].data[0].position);
     #endif
     }
-    globalRestLength += restLength;
-    globalCntEdges += cntEdges;
   #if IN_PLACE
-    nodes[i].data.restLength = restLength / static_cast<phys_t>(cntEdges);
+    nodes[i].data.restLength = restLength;
   #else
-    nodes[i].data[0].restLength = restLength / static_cast<phys_t>(cntEdges);
-    nodes[i].data[1].restLength = restLength / static_cast<phys_t>(cntEdges);
+    nodes[i].data[0].restLength = restLength;
   #endif
   }
-  globaldata->restLength = globalRestLength / static_cast<phys_t>(globalCntEdges);
-#if USE_GLOBAL_REST_LENGTH
+  phys_t globalRestLength = 0.0;
   for (vid_t i = 0; i < cntNodes; i++) {
   #if IN_PLACE
-    nodes[i].data.restLength = globaldata->restLength;
+    globalRestLength += nodes[i].data.restLength;
   #else
-    nodes[i].data[0].restLength = globaldata->restLength;
-    nodes[i].data[1].restLength = globaldata->restLength;
+    globalRestLength += nodes[i].data[0].restLength;
+  #endif
+  }
+  const vid_t globalCntEdges = parallelSum<vid_t>(cntNodes, [nodes](const vid_t i) {
+    return nodes[i].cntEdges;
+  });
+  globaldata->restLength = globalRestLength / static_cast<phys_t>(globalCntEdges);
+  cilk_for (vid_t i = 0; i < cntNodes; i++) {
+  #if USE_GLOBAL_REST_LENGTH
+    const phys_t restLength = globaldata->restLength;
+  #elif IN_PLACE
+    const phys_t restLength = nodes[i].data.restLength
+      / static_cast<phys_t>(nodes[i].cntEdges);
+  #else
+    const phys_t restLength = nodes[i].data[0].restLength
+      / static_cast<phys_t>(nodes[i].cntEdges);
+  #endif
+  #if IN_PLACE
+    nodes[i].data.restLength = restLength;
+  #else
+    nodes[i].data[0].restLength = restLength;
+    nodes[i].data[1].restLength = restLength;
   #endif
   }
-#endif
 #if PRINT_EDGE_LENGTH_HISTOGRAM
   globaldata->edgeLengthsBefore = new (std::nothrow) phys_t[NUM_BUCKETS];
   globaldata->edgeLengthsAfter = new (std::nothrow) phys_t[NUM_BUCKETS];
@@ -467,12 +580,7 @@ inline void update(vertex_t * const nodes,
   getNetForce(nodes, index, acceleration, globaldata, round, useLeapFrogMethod);
 #if TEST_CONVERGENCE
   phys_t tmpNetForce = length(acceleration);
-  globaldata->sumSquareNetForce[round] += tmpNetForce*tmpNetForce;
-  //  Serial access to globaldata->averageSpeed is essential to
-  //  avoid data races.  Access to this variable is serialized
-  //  in any case, so parallel computation wouldn't gain much,
-  //  if anything.
-  assert(PARALLEL == 0);
+  globaldata->sumSquareNetForce.add(round, tmpNetForce*tmpNetForce);
 #endif
   for (int d = 0; d < DIMENSIONS; d++) {
     acceleration[d] *= globaldata->springStiffness;
@@ -480,6 +588,12 @@ inline void update(vertex_t * const nodes,
     next->velocity[d] = acceleration[d]*globaldata->timeStep + current->velocity[d];
     next->position[d] = current->position[d] + next->velocity[d]*globaldata->timeStep;
   }
+#if FUSED_CONVERGENCE
+  if (round == globaldata->convergenceRound) {
+    const phys_t v = length(next->velocity);
+    addToFusedConvergence((v * v) / (2 * globaldata->inverseMass));
+  }
+#endif
 }
 
 #endif  // MSD_UPDATE_FUNCTION_H_
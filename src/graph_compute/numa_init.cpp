@@ -1,11 +1,13 @@
 #include "./numa_init.h"
 #include <algorithm>
 #include <iostream>
+#include "./topology.h"
 
 void * writeZeroes(void * param) {
   chunkInit_t * config = static_cast<chunkInit_t *>(param);
   // Initialize the chunk
-  bindThreadToCore(config->coreID);
+  //  the same CPU as the worker that will process this part
+  bindThreadToWorkerCpu(config->coreID);
   size_t chunkSize = config->dataTypeSize << config->numaInit.chunkBits;
   static const size_t PAGE_SIZE = 4096;
   if (config->numBytes > PAGE_SIZE) {
@@ -45,23 +45,6 @@ void numaInitWriteZeroes(numaInit_t config,
                          void *data,
                          size_t numBytes);
 
-//  http://stackoverflow.com/questions
-//  /1407786/how-to-set-cpu-affinity-of-a-particular-pthread
-// _coreID = 0, 1, ... n-1, where n is the system's number of cores
-inline int bindThreadToCore(int _coreID) {
-  int numCores = sysconf(_SC_NPROCESSORS_ONLN);
-  if (_coreID < 0 || _coreID >= numCores) {
-    return EINVAL;
-  }
-
-  cpu_set_t cpuset;
-  CPU_ZERO(&cpuset);
-  CPU_SET(_coreID, &cpuset);
-
-  pthread_t current_thread = pthread_self();
-  return pthread_setaffinity_np(current_thread, sizeof(cpu_set_t), &cpuset);
-}
-
 void * numaCalloc(numaInit_t config, size_t dataTypeSize, size_t numElements);
 
 #endif  // NUMA_INIT_H_
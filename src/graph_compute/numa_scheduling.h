@@ -3,11 +3,19 @@
 
 #if D1_NUMA
 
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
 #include <algorithm>
-#include <unordered_set>
 #include "./common.h"
 #include "./concurrent_queue.h"
 #include "./numa_init.h"
+#include "./topology.h"
+#include "./reduction.h"
+#include "./timing.h"
+#include "./perf_counters.h"
+#include "./chunk_trace.h"
+#include "./memory_accounting.h"
 
 #if CHUNK_BITS < 1
   #error "CHUNK_BITS needs to be greater than 0 for D1_NUMA"
@@ -31,14 +39,15 @@ typedef struct sched_t sched_t;
 
 // there is one of these per chunk
 struct chunkdata_t {
-  //  the index of the first vertex beyond this chunk
-  //  this could be generalized to an arbitrary number of phases, but is not currently
-  vid_t phaseEndIndex[2];
+  //  the index of the first vertex beyond each phase of this chunk
+  vid_t phaseEndIndex[NUM_PHASES];
   vid_t workQueueNumber;
   volatile vid_t nextIndex;  // the next vertex in this chunk to be processed
 };
 typedef struct chunkdata_t chunkdata_t;
 
+#include "./chunk_phases.h"
+
 struct scheddata_t;
 
 struct numaSchedInit_t {
@@ -49,9 +58,17 @@ struct numaSchedInit_t {
   vertex_t * nodes;
   scheddata_t * scheddata;
   global_t * globaldata;
-  mrmw_queue_t * workQueue;
+  ws_deque_t * workQueue;  //  the chunks this worker runs or others steal
+  mrmw_queue_t * mailbox;  //  chunks of this worker released by other workers
   volatile int * remainingChunks;
   volatile int * remainingStragglers;
+  //  the other workers, nearest first: a thief at level l picks its
+  //  victims from victims[0 .. victimsEnd[l]-1], over the levels of
+  //  stealLevel_t that have any workers
+  int victims[NUMA_WORKERS];
+  int victimsEnd[CNT_STEAL_LEVELS];
+  int cntVictimLevels;
+  stealLevel_t victimLevel[NUMA_WORKERS];  //  how far away each worker is
 };
 typedef struct numaSchedInit_t numaSchedInit_t;
 
@@ -65,11 +82,34 @@ struct scheddata_t {
   numaSchedInit_t * numaSchedInit;  // init struct for pthreads
   chunkdata_t * chunkdata;  //  each chunk has metadata for its processing
   volatile vid_t * queueData;  //  data array for worker queues
+  volatile vid_t * mailboxData;  //  data array for worker mailboxes
+  //  the work-stealing deques, which new cannot align to cache lines
+  padded_t<ws_deque_t> * deques;
   vid_t cntChunks;
   vid_t numChunksPerWorker;
 };
 typedef struct scheddata_t scheddata_t;
 
+#if NUMA_TELEMETRY
+//  there is one of these per worker, each on its own cache lines;
+//  the counters accumulate over all rounds of the run
+struct numaTelemetry_t {
+  uint64_t localChunks;  //  chunks popped from the worker's own queue
+  uint64_t stolenChunks;  //  chunks popped from another worker's queue
+  uint64_t stolenByLevel[CNT_STEAL_LEVELS];  //  stolenChunks by the victim's stealLevel_t
+  uint64_t failedSteals;  //  steals from another worker's queue that got nothing
+  uint64_t shelvedChunks;  //  chunks put aside on an unsatisfied vertex
+  uint64_t vertices;  //  vertices updated
+  uint64_t barrierCycles;  //  cycles spent waiting on remainingStragglers
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+typedef struct numaTelemetry_t numaTelemetry_t;
+
+static inline numaTelemetry_t * numaTelemetry() {
+  static numaTelemetry_t telemetry[NUMA_WORKERS];
+  return telemetry;
+}
+#endif
+
 template<typename T>
 inline T logBaseTwoRoundUp(T x) {
   T power = 0;
@@ -86,74 +126,52 @@ inline uint32_t randomValue(const uint32_t seed,
   return __builtin_ia32_crc32si(randVal, seed);
 }
 
-static inline bool samePhase(vid_t v, vid_t w, chunkdata_t * const chunkdata) {
-  // this assumes that the boundary between phases is the
-  // midpoint of the chunk - we will generalize later
-  // to a custom boundary to optimize overall work
-  bool vPhase = v < chunkdata[v >> CHUNK_BITS].phaseEndIndex[0];
-  bool wPhase = w < chunkdata[w >> CHUNK_BITS].phaseEndIndex[0];
-  return (vPhase == wPhase);
-}
-
-static inline bool interChunkDependency(vid_t v, vid_t w) {
-  static const vid_t chunkMask = (1 << CHUNK_BITS) - 1;
-  if ((v >> CHUNK_BITS) == (w >> CHUNK_BITS)) {
-    return false;
-  } else if ((v & chunkMask) == (w & chunkMask)) {
-    return (v < w);
-  } else {
-    return ((v & chunkMask) < (w & chunkMask));
-  }
-}
-
-static inline void calculateNeighborhood(std::unordered_set<vid_t> * neighbors,
-                                         std::unordered_set<vid_t> * oldNeighbors,
-                                         vid_t v,
-                                         vertex_t * const nodes,
-                                         vid_t distance) {
-  neighbors->clear();
-  neighbors->insert(v);
-  oldNeighbors->clear();
-  for (vid_t d = 0; d < distance; d++) {
-    *oldNeighbors = *neighbors;
-    for (const auto& v : *oldNeighbors) {
-      for (vid_t j = 0; j < nodes[v].cntEdges; j++) {
-        if (oldNeighbors->count(nodes[v].edges[j]) == 0) {
-          neighbors->insert(nodes[v].edges[j]);
+//  Orders the victims of every worker by where the other workers' CPUs
+//  sit relative to its own (see PIN_POLICY)
+static inline void createVictimLists(numaSchedInit_t * const numaSchedInit) {
+  for (int i = 0; i < NUMA_WORKERS; i++) {
+    numaSchedInit_t * config = &numaSchedInit[i];
+    for (int j = 0; j < NUMA_WORKERS; j++) {
+      config->victimLevel[j] = stealLevel(workerPlace(i), workerPlace(j));
+    }
+    int cntVictims = 0;
+    config->cntVictimLevels = 0;
+    for (int level = 0; level < CNT_STEAL_LEVELS; level++) {
+      const int levelStart = cntVictims;
+      for (int j = 0; j < NUMA_WORKERS; j++) {
+        if ((j != i) && (config->victimLevel[j] == level)) {
+          config->victims[cntVictims++] = j;
         }
       }
+      if (cntVictims > levelStart) {
+        config->victimsEnd[config->cntVictimLevels++] = cntVictims;
+      }
     }
   }
 }
 
+//  A random victim among the nearest workers.  A thief widens the search
+//  to the next level after NUMA_STEAL_ATTEMPTS failed steals in a row.
+static inline int chooseVictim(const numaSchedInit_t * const config,
+                               const int failedSteals, uint32_t * const seed) {
+  if (config->cntVictimLevels == 0) {
+    return config->coreID;
+  }
+  int level = config->cntVictimLevels - 1;
+#if NUMA_STEAL_ATTEMPTS > 0
+  level = std::min(failedSteals / NUMA_STEAL_ATTEMPTS, level);
+#endif
+  *seed = randomValue(*seed) + 1;
+  return config->victims[*seed % config->victimsEnd[level]];
+}
+
 static inline void calculateNodeDependenciesChunk(vertex_t * const nodes,
                                                   const vid_t cntNodes,
                                                   scheddata_t * const scheddata) {
-  vid_t * dependentEdgeIndex = new (std::nothrow) vid_t[cntNodes];
-  vid_t cntDependencies = 0;
-  std::unordered_set<vid_t> neighbors;
-  neighbors.reserve(1024);
-  std::unordered_set<vid_t> oldNeighbors;
-  oldNeighbors.reserve(1024);
-  for (vid_t i = 0; i < cntNodes; i++) {
-    calculateNeighborhood(&neighbors, &oldNeighbors, i, nodes, DISTANCE);
-    dependentEdgeIndex[i] = cntDependencies;
-    sched_t * node = &nodes[i].sched;
-    node->dependencies = 0;
-    node->cntDependentEdges = 0;
-    for (const auto& neighbor : neighbors) {
-      if (samePhase(neighbor, i, scheddata->chunkdata)) {
-        if (interChunkDependency(neighbor, i)) {
-          node->dependencies++;
-        } else if (interChunkDependency(i, neighbor)) {
-          cntDependencies++;
-          node->cntDependentEdges++;
-        }
-      }
-    }
-    node->satisfied = node->dependencies;
-  }
+  calculatePhaseDependencies(nodes, cntNodes, scheddata->chunkdata,
+                             &scheddata->dependentEdges);
   WHEN_TEST({
+    vid_t cntDependencies = 0;
     vid_t syncLessVertices = 0;
     vid_t verticesWithNoDecrements = 0;
     vid_t verticesWithDepsSatisfiedByConstr = 0;
@@ -163,6 +181,7 @@ static inline void calculateNodeDependenciesChunk(vertex_t * const nodes,
       // If both of these are zero, processing the vertex requires no synchronization.
       bool noDecrements = (nodes[i].sched.cntDependentEdges == 0);
       bool dependenciesSatisfiedByConstruction = (nodes[i].sched.dependencies == 0);
+      cntDependencies += nodes[i].sched.cntDependentEdges;
 
       if (noDecrements && dependenciesSatisfiedByConstruction) {
         verticesWithNoDecrements++;
@@ -182,22 +201,6 @@ static inline void calculateNodeDependenciesChunk(vertex_t * const nodes,
       static_cast<uint64_t>(verticesWithDepsSatisfiedByConstr),
       static_cast<uint64_t>(syncLessVertices));
   })
-  numaInit_t numaInit(NUMA_WORKERS,
-                      CHUNK_BITS, static_cast<bool>(NUMA_INIT));
-  scheddata->dependentEdges =
-    static_cast<vid_t *>(numaCalloc(numaInit, sizeof(vid_t), cntDependencies+1));
-  for (vid_t i = 0; i < cntNodes; i++) {
-    nodes[i].sched.dependentEdges = &scheddata->dependentEdges[dependentEdgeIndex[i]];
-    calculateNeighborhood(&neighbors, &oldNeighbors, i, nodes, DISTANCE);
-    vid_t curIndex = dependentEdgeIndex[i];
-    for (const auto& neighbor : neighbors) {
-      if ((samePhase(neighbor, i, scheddata->chunkdata))
-        && (interChunkDependency(i, neighbor))) {
-          scheddata->dependentEdges[curIndex++] = neighbor;
-      }
-    }
-  }
-  delete[] dependentEdgeIndex;
 }
 
 static inline void createChunkData(vertex_t * const nodes,
@@ -206,30 +209,29 @@ static inline void createChunkData(vertex_t * const nodes,
   scheddata->cntChunks = (cntNodes + (1 << CHUNK_BITS) - 1) >> CHUNK_BITS;
   scheddata->chunkdata = new (std::nothrow) chunkdata_t[scheddata->cntChunks]();
   assert(scheddata->chunkdata != NULL);
+  trackAllocation("chunkdata", scheddata->chunkdata,
+                  sizeof(chunkdata_t) * scheddata->cntChunks);
   scheddata->numChunksPerWorker =
     (scheddata->cntChunks + NUMA_WORKERS - 1) / NUMA_WORKERS;
 
   cilk_for (vid_t i = 0; i < scheddata->cntChunks; ++i) {
     chunkdata_t * chunk = &scheddata->chunkdata[i];
     chunk->nextIndex = i << CHUNK_BITS;
-    chunk->phaseEndIndex[0] = std::min(chunk->nextIndex + (1 << (CHUNK_BITS - 1)),
-      cntNodes);
-    chunk->phaseEndIndex[1] = std::min((i + 1) << CHUNK_BITS, cntNodes);
     chunk->workQueueNumber = i / scheddata->numChunksPerWorker;
     WHEN_TEST(
       assert(chunk->workQueueNumber < NUMA_WORKERS);
     )
-    // put code to greedily move boundaryIndex to minimize cost of
-    // interChunk dependencies here
   }
+  createPhaseBoundaries(nodes, cntNodes, scheddata->chunkdata);
 }
 
 static inline void populateWorkerParameters(vertex_t * const nodes,
                                             const vid_t cntNodes,
                                             scheddata_t * const scheddata) {
-  const int NUM_PHASES = 2;
   scheddata->numaSchedInit =
     static_cast<numaSchedInit_t *>(malloc(sizeof(numaSchedInit_t)*NUMA_WORKERS));
+  trackAllocation("numaSchedInit", scheddata->numaSchedInit,
+                  sizeof(numaSchedInit_t) * NUMA_WORKERS);
   numaSchedInit_t * numaSchedInit = scheddata->numaSchedInit;
   //  a set of NUMA_WORKERS work queues for manages chunks
   vid_t logChunksPerWorker = logBaseTwoRoundUp<vid_t>((cntNodes >> CHUNK_BITS) + 1);
@@ -238,6 +240,16 @@ static inline void populateWorkerParameters(vertex_t * const nodes,
   scheddata->queueData =
     static_cast<vid_t *>(numaCalloc(numaInit, sizeof(vid_t),
                                     NUMA_WORKERS << logChunksPerWorker));
+  trackAllocation("queueData", const_cast<vid_t *>(scheddata->queueData),
+                  sizeof(vid_t) * (NUMA_WORKERS << logChunksPerWorker));
+  scheddata->mailboxData =
+    static_cast<vid_t *>(numaCalloc(numaInit, sizeof(vid_t),
+                                    NUMA_WORKERS << logChunksPerWorker));
+  trackAllocation("mailboxData", const_cast<vid_t *>(scheddata->mailboxData),
+                  sizeof(vid_t) * (NUMA_WORKERS << logChunksPerWorker));
+  scheddata->deques = allocatePadded<ws_deque_t>(NUMA_WORKERS);
+  trackAllocation("deques", scheddata->deques,
+                  sizeof(padded_t<ws_deque_t>) * NUMA_WORKERS);
   for (int i = 0; i < NUMA_WORKERS; i++) {
     numaSchedInit[i].coreID = i;
     numaSchedInit[i].numPhases = NUM_PHASES;
@@ -245,9 +257,15 @@ static inline void populateWorkerParameters(vertex_t * const nodes,
     numaSchedInit[i].nodes = nodes;
     numaSchedInit[i].scheddata = scheddata;
     numaSchedInit[i].workQueue =
-      new (std::nothrow) mrmw_queue_t(&scheddata->queueData[i << logChunksPerWorker],
+      new (&scheddata->deques[i].value) ws_deque_t(
+        &scheddata->queueData[i << logChunksPerWorker], logChunksPerWorker,
+        static_cast<vid_t>(-1));
+    numaSchedInit[i].mailbox =
+      new (std::nothrow) mrmw_queue_t(&scheddata->mailboxData[i << logChunksPerWorker],
                                       logChunksPerWorker, static_cast<vid_t>(-1));
+    assert(numaSchedInit[i].mailbox != NULL);
   }
+  createVictimLists(numaSchedInit);
 }
 
 static inline void init_scheduling(vertex_t * const nodes,
@@ -258,57 +276,125 @@ static inline void init_scheduling(vertex_t * const nodes,
   populateWorkerParameters(nodes, cntNodes, scheddata);
 }
 
+//  Only the owner of a deque may push on it, so a chunk released by
+//  another worker waits in its home worker's mailbox.  The owner drains
+//  it into its deque before taking the newest chunk, and thieves that
+//  find the deque empty pop from the mailbox instead.
+static inline vid_t takeLocalChunk(numaSchedInit_t * const config) {
+  static const vid_t SENTINEL = static_cast<vid_t>(-1);
+  vid_t chunk = config->mailbox->pop();
+  while (chunk != SENTINEL) {
+    config->workQueue->push(chunk);
+    chunk = config->mailbox->pop();
+  }
+  return config->workQueue->take();
+}
+
 inline void * processChunks(void * param) {
   numaSchedInit_t * config = static_cast<numaSchedInit_t *>(param);
   scheddata_t * scheddata = config->scheddata;
   numaSchedInit_t * numaSchedInit = scheddata->numaSchedInit;
 
   // Initialize the chunk
-  bindThreadToCore(config->coreID);
+  bindThreadToWorkerCpu(config->coreID);
+  setWorkerNumber(config->coreID);
+#if PERF_COUNTERS
+  perfGroup_t perfGroup;
+  const bool countingPerf = startWorkerPerfCounters(&perfGroup);
+#endif
   static const vid_t SENTINEL = static_cast<vid_t>(-1);
 
-  vid_t stealQueueNumber = config->coreID;
+#if NUMA_TELEMETRY
+  numaTelemetry_t * const telemetry = &numaTelemetry()[config->coreID];
+#endif
+
+  int victim = config->coreID;
+  int failedSteals = 0;
   uint32_t seed = static_cast<uint32_t>(config->coreID) + 1;
   seed *= static_cast<uint32_t>(numaSchedInit->cntNodes);
-  static const uint32_t queueNumberMask
-    = (1 << logBaseTwoRoundUp<uint32_t>(NUMA_WORKERS)) - 1;
 
   for (int round = 0; round < config->numRounds; round++) {
     for (int phase = 0; phase < config->numPhases; phase++) {
       //  load up chunks that belong to me
       __sync_sub_and_fetch(config->remainingStragglers, 1);
+    #if NUMA_TELEMETRY || CHUNK_TRACE
+      const uint64_t barrierStart = readCycleCounter();
+    #endif
       //  wait until all workers have reached the barrier
       while (static_cast<int>(*config->remainingStragglers) > 0) {}
+    #if NUMA_TELEMETRY || CHUNK_TRACE
+      const uint64_t barrierEnd = readCycleCounter();
+    #endif
+    #if NUMA_TELEMETRY
+      telemetry->barrierCycles += barrierEnd - barrierStart;
+    #endif
+    #if CHUNK_TRACE
+      traceInterval(TRACE_BARRIER, barrierStart, barrierEnd, round, phase);
+    #endif
       vid_t start = config->coreID*scheddata->numChunksPerWorker;
       vid_t end = (config->coreID + 1)*scheddata->numChunksPerWorker;
       end = std::min(end, scheddata->cntChunks);
       config->workQueue->push(start, end);
       //  start with your own queue - you just put stuff in it
-      stealQueueNumber = config->coreID;
+      victim = config->coreID;
+      failedSteals = 0;
       //  When somebody completes the last chunk, they'll reset
       //  the config->remainingStragglers variable.
       while (static_cast<int>(*config->remainingStragglers) == 0) {
         vid_t chunk;
       #if NUMA_STEAL
         //  try to get a chunk from my own queue
-        chunk = numaSchedInit[config->coreID].workQueue->pop();
+        chunk = takeLocalChunk(config);
       #else
         chunk = SENTINEL;
+      #endif
+      #if NUMA_TELEMETRY || CHUNK_TRACE
+        bool stolen = false;
       #endif
         while ((chunk == SENTINEL)
                && (static_cast<int>(*config->remainingStragglers) == 0)) {
-          //  randomly steal
-          chunk = numaSchedInit[stealQueueNumber].workQueue->pop();
-          if (chunk == SENTINEL) {
-            seed = randomValue(seed) + 1;
-            stealQueueNumber = seed & queueNumberMask;
-            //  finding queueNumber % numCores
-            if (stealQueueNumber >= NUMA_WORKERS) {
-              stealQueueNumber -= NUMA_WORKERS;
+          if (victim == config->coreID) {
+            chunk = takeLocalChunk(config);
+          } else {
+            //  my own chunks released by other workers come first
+            chunk = config->mailbox->pop();
+            if (chunk == SENTINEL) {
+              chunk = numaSchedInit[victim].workQueue->steal();
+              if (chunk == SENTINEL) {
+                //  the victim may be busy in a long chunk
+                chunk = numaSchedInit[victim].mailbox->pop();
+              }
+            #if NUMA_TELEMETRY || CHUNK_TRACE
+              stolen = (chunk != SENTINEL);
+            #endif
+            #if NUMA_TELEMETRY
+              if (chunk == SENTINEL) {
+                telemetry->failedSteals++;
+              }
+            #endif
             }
           }
+          if (chunk == SENTINEL) {
+            failedSteals++;
+            victim = chooseVictim(config, failedSteals, &seed);
+          }
         }
         if (chunk != SENTINEL) {
+          //  the next failed steal starts over with the nearest workers
+          failedSteals = 0;
+        #if NUMA_TELEMETRY
+          if (stolen) {
+            telemetry->stolenChunks++;
+            telemetry->stolenByLevel[config->victimLevel[victim]]++;
+          } else {
+            telemetry->localChunks++;
+          }
+        #endif
+        #if CHUNK_TRACE
+          const uint64_t chunkStart = readCycleCounter();
+          vid_t cntUpdated = 0;
+          uint8_t traceFlags = stolen ? TRACE_STOLEN : 0;
+        #endif
           bool doneFlag = false;
           //  keep processing vertices from this chunk until it
           //  gets shelved or is done for this phase
@@ -322,22 +408,38 @@ inline void * processChunks(void * param) {
                   && (__sync_sub_and_fetch(&node->satisfied, 1) != SENTINEL)) {
                 //  If we need to shelve vertex, we're done with the chunk
                 doneFlag = true;
+              #if NUMA_TELEMETRY
+                telemetry->shelvedChunks++;
+              #endif
+              #if CHUNK_TRACE
+                traceFlags |= TRACE_SHELVED;
+              #endif
               } else {
                 //  otherwise we process the vertex and decrement those
                 //  vertices dependent on it
                 update(config->nodes, chunkdata->nextIndex, config->globaldata, round);
+              #if NUMA_TELEMETRY
+                telemetry->vertices++;
+              #endif
+              #if CHUNK_TRACE
+                cntUpdated++;
+              #endif
                 if (DISTANCE > 0) {
                   node->satisfied = node->dependencies;
                   for (vid_t edge = 0; edge < node->cntDependentEdges; edge++) {
                     //  if we discover a dependent vertex that we enable, we
-                    //  push it on the appropriate work queue
+                    //  push its chunk on its home worker's queue or mailbox
                     sched_t * neighbor = &config->nodes[node->dependentEdges[edge]].sched;
                     if (__sync_sub_and_fetch(&neighbor->satisfied, 1) == SENTINEL) {
                       //  Released this chunk, so push it on its home work queue
                       vid_t enabledChunk = node->dependentEdges[edge] >> CHUNK_BITS;
                       vid_t queueNumber =
                         scheddata->chunkdata[enabledChunk].workQueueNumber;
-                      numaSchedInit[queueNumber].workQueue->push(enabledChunk);
+                      if (queueNumber == static_cast<vid_t>(config->coreID)) {
+                        config->workQueue->push(enabledChunk);
+                      } else {
+                        numaSchedInit[queueNumber].mailbox->push(enabledChunk);
+                      }
                     }
                   }
                 }
@@ -363,10 +465,18 @@ inline void * processChunks(void * param) {
               }
             }
           }
+        #if CHUNK_TRACE
+          traceChunk(chunkStart, chunk, cntUpdated, round, phase, traceFlags);
+        #endif
         }
       }
     }
   }
+#if PERF_COUNTERS
+  if (countingPerf) {
+    stopWorkerPerfCounters(&perfGroup, config->coreID);
+  }
+#endif
   return NULL;
 }
 
@@ -402,18 +512,101 @@ static inline void execute_rounds(const int numRounds,
   }
 }
 
+#if NUMA_TELEMETRY
+//  Writes one CSV line per worker to the file named by the environment
+//  variable NUMA_TELEMETRY_FILE (numa_telemetry.csv by default)
+static inline void writeNumaTelemetry() {
+  const char * filepath = getenv("NUMA_TELEMETRY_FILE");
+  if (filepath == NULL) {
+    filepath = "numa_telemetry.csv";
+  }
+  FILE * file = fopen(filepath, "w");
+  if (file == NULL) {
+    cerr << "WARNING: Could not write NUMA telemetry to " << filepath << endl;
+    return;
+  }
+  fprintf(file, "worker,local_chunks,stolen_chunks,stolen_smt,stolen_llc,"
+                "stolen_node,stolen_remote,failed_steals,shelved_chunks,vertices,"
+                "barrier_cycles\n");
+  const numaTelemetry_t * telemetry = numaTelemetry();
+  for (int i = 0; i < NUMA_WORKERS; i++) {
+    fprintf(file, "%d,%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64
+                  ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 ",%" PRIu64 "\n", i,
+            telemetry[i].localChunks, telemetry[i].stolenChunks,
+            telemetry[i].stolenByLevel[STEAL_SMT], telemetry[i].stolenByLevel[STEAL_LLC],
+            telemetry[i].stolenByLevel[STEAL_NODE],
+            telemetry[i].stolenByLevel[STEAL_REMOTE], telemetry[i].failedSteals,
+            telemetry[i].shelvedChunks,
+            telemetry[i].vertices, telemetry[i].barrierCycles);
+  }
+  fclose(file);
+}
+
+static inline void printNumaTelemetry() {
+  const numaTelemetry_t * telemetry = numaTelemetry();
+  numaTelemetry_t total = numaTelemetry_t();
+  uint64_t minVertices = telemetry[0].vertices;
+  uint64_t maxVertices = telemetry[0].vertices;
+  uint64_t maxBarrierCycles = 0;
+  for (int i = 0; i < NUMA_WORKERS; i++) {
+    total.localChunks += telemetry[i].localChunks;
+    total.stolenChunks += telemetry[i].stolenChunks;
+    for (int level = 0; level < CNT_STEAL_LEVELS; level++) {
+      total.stolenByLevel[level] += telemetry[i].stolenByLevel[level];
+    }
+    total.failedSteals += telemetry[i].failedSteals;
+    total.shelvedChunks += telemetry[i].shelvedChunks;
+    total.vertices += telemetry[i].vertices;
+    total.barrierCycles += telemetry[i].barrierCycles;
+    minVertices = std::min(minVertices, telemetry[i].vertices);
+    maxVertices = std::max(maxVertices, telemetry[i].vertices);
+    maxBarrierCycles = std::max(maxBarrierCycles, telemetry[i].barrierCycles);
+  }
+  cout << "Chunks popped locally: " << total.localChunks << '\n';
+  cout << "Chunks stolen: " << total.stolenChunks
+       << " (SMT sibling " << total.stolenByLevel[STEAL_SMT]
+       << ", same LLC " << total.stolenByLevel[STEAL_LLC]
+       << ", same node " << total.stolenByLevel[STEAL_NODE]
+       << ", remote " << total.stolenByLevel[STEAL_REMOTE] << ")\n";
+  cout << "Failed steal attempts: " << total.failedSteals << '\n';
+  cout << "Chunks shelved: " << total.shelvedChunks << '\n';
+  cout << "Vertices updated: " << total.vertices
+       << " (per worker: min " << minVertices << ", max " << maxVertices << ")\n";
+  cout << "Barrier spin cycles: " << total.barrierCycles
+       << " (per worker: max " << maxBarrierCycles << ")\n";
+}
+#endif
+
 static inline void cleanup_scheduling(vertex_t * const nodes,
                                       const vid_t cntNodes,
                                       scheddata_t * const scheddata) {
+#if NUMA_TELEMETRY
+  writeNumaTelemetry();
+#endif
+#if CHUNK_TRACE
+  writeChunkTrace();
+#endif
+  for (int i = 0; i < NUMA_WORKERS; i++) {
+    delete scheddata->numaSchedInit[i].mailbox;
+  }
+  freePadded(scheddata->deques);
   delete[] scheddata->chunkdata;
-  delete[] scheddata->dependentEdges;
-  delete[] scheddata->numaSchedInit;
-  delete[] scheddata->queueData;
+  //  these come from malloc and numaCalloc
+  free(scheddata->dependentEdges);
+  free(scheddata->numaSchedInit);
+  free(const_cast<vid_t *>(scheddata->queueData));
+  free(const_cast<vid_t *>(scheddata->mailboxData));
 }
 
 static inline void print_execution_data() {
   cout << "Chunk size bits: " << CHUNK_BITS << '\n';
   cout << "Number of workers: " << NUMA_WORKERS << '\n';
+  cout << "Phases: " << NUM_PHASES << '\n';
+  cout << "Steal attempts per level: " << NUMA_STEAL_ATTEMPTS << '\n';
+  cout << "Pinning policy: " << PIN_POLICY_NAME << '\n';
+#if NUMA_TELEMETRY
+  printNumaTelemetry();
+#endif
 }
 
 #endif  // D1_NUMA
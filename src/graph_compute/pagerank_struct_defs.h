@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
 
 typedef double pagerank_t;
 
@@ -17,8 +18,12 @@ struct data_t {
 struct global_t {
   pagerank_t d;
 
+  #if FUSED_CONVERGENCE
+    int convergenceRound;  //  updates in this round add to the convergence data
+  #endif
+
   #if TEST_CONVERGENCE
-    pagerank_t * averageDiff;
+    worker_rows_t<pagerank_t> sumSquareDelta;  //  one column per round
   #endif
 };
 
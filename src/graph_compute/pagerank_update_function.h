@@ -6,6 +6,7 @@
 #include <string>
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
 
 using namespace std;
 
@@ -20,7 +21,7 @@ inline static uint64_t hashOfVertexData(const data_t * vertex) {
 
 inline static void fillInNodeData(vertex_t * const nodes,
                                   const vid_t cntNodes) {
-  for (vid_t i = 0; i < cntNodes; i++) {
+  cilk_for (vid_t i = 0; i < cntNodes; i++) {
   #if IN_PLACE
     nodes[i].data.pagerank = 1.0;
     nodes[i].data.contrib = 1.0/static_cast<pagerank_t>(nodes[i].cntEdges);
@@ -38,8 +39,11 @@ inline static void fillInGlobalData(vertex_t * const nodes,
                                     global_t * const globaldata,
                                     int numRounds) {
   globaldata->d = .85;
+#if FUSED_CONVERGENCE
+  globaldata->convergenceRound = -1;
+#endif
 #if TEST_CONVERGENCE
-  globaldata->averageDiff = new (std::nothrow) pagerank_t[numRounds]();
+  globaldata->sumSquareDelta.init(numRounds);
 #endif
 }
 
@@ -48,9 +52,9 @@ inline static void printConvergenceData(const vertex_t * const nodes,
                                         const global_t * const globaldata,
                                         const int numRounds) {
 #if TEST_CONVERGENCE
-  pagerank_t normalizer = 1/globaldata->sumSquareDelta[0];
+  pagerank_t normalizer = 1/globaldata->sumSquareDelta.sum(0);
   for (int i = 0; i < numRounds; i++) {
-    cout << sqrt(globaldata->sumSquareDelta[i]*normalizer) << endl;
+    cout << sqrt(globaldata->sumSquareDelta.sum(i)*normalizer) << endl;
   }
 #endif
 }
@@ -83,14 +87,32 @@ static inline double getConvergenceData(const vertex_t * const nodes,
                                         const vid_t cntNodes,
                                         const global_t * const globaldata,
                                         const int round) {
-  pagerank_t sumSquareDelta = 0.0;
-  for (vid_t v = 0; v < cntNodes; v++) {
-    pagerank_t delta = getDelta(nodes, v, globaldata, round);
-    sumSquareDelta += delta * delta;
-  }
+  const pagerank_t sumSquareDelta = parallelSum<pagerank_t>(cntNodes,
+    [nodes, globaldata, round](const vid_t v) {
+      const pagerank_t delta = getDelta(nodes, v, globaldata, round);
+      return delta * delta;
+    });
   return static_cast<double>(sqrt(sumSquareDelta / static_cast<pagerank_t>(cntNodes)));
 }
 
+#if FUSED_CONVERGENCE
+//  The updates of the given round add their squared change in pagerank
+//  to per-worker sums.  This measures the residual of the state before
+//  that round, i.e., it lags getConvergenceData by one round.
+static inline void startFusedConvergence(global_t * const globaldata,
+                                         const int round) {
+  collectFusedConvergence();
+  globaldata->convergenceRound = round;
+}
+
+static inline double finishFusedConvergence(const vid_t cntNodes,
+                                            global_t * const globaldata) {
+  globaldata->convergenceRound = -1;
+  const double sumSquareDelta = collectFusedConvergence();
+  return sqrt(sumSquareDelta / static_cast<double>(cntNodes));
+}
+#endif
+
 static inline double getInitialConvergenceData(const vertex_t * const nodes,
                                                const vid_t cntNodes,
                                                const global_t * const globaldata) {
@@ -129,12 +151,17 @@ inline void update(vertex_t * const nodes,
   data_t * current = &nodes[index].data[round & 1];
 #endif
   pagerank_t delta = pagerank - current->pagerank;
-  globaldata->sumSquareDelta[round] += delta;
-  //  Serial access to globaldata->averageSpeed is essential to
-  //  avoid data races.  Access to this variable is serialized
-  //  in any case, so parallel computation wouldn't gain much,
-  //  if anything.
-  assert(PARALLEL == 0);
+  globaldata->sumSquareDelta.add(round, delta*delta);
+#endif
+#if FUSED_CONVERGENCE
+  if (round == globaldata->convergenceRound) {
+  #if IN_PLACE
+    const pagerank_t delta = pagerank - nodes[index].data.pagerank;
+  #else
+    const pagerank_t delta = pagerank - nodes[index].data[round & 1].pagerank;
+  #endif
+    addToFusedConvergence(delta * delta);
+  }
 #endif
   next->pagerank = pagerank;
   next->contrib = pagerank / static_cast<pagerank_t>(nodes[index].cntEdges);
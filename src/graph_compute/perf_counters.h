@@ -0,0 +1,249 @@
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#include "./common.h"
+
+#if PERF_COUNTERS
+
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+#include <cerrno>
+#include <cinttypes>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include "./reduction.h"
+
+using namespace std;
+
+static const int PERF_EVENTS = 5;
+
+static const char * const PERF_EVENT_NAMES[PERF_EVENTS] = {
+  "cycles", "instructions", "llc_misses", "dtlb_misses", "stalled_cycles"
+};
+
+//  The first event leads the group; user space only, like the :u
+//  events in scripts/paper_benchmarks/perf_counters.sh
+static const uint32_t PERF_EVENT_TYPES[PERF_EVENTS] = {
+  PERF_TYPE_HARDWARE,
+  PERF_TYPE_HARDWARE,
+  PERF_TYPE_HW_CACHE,
+  PERF_TYPE_HW_CACHE,
+  PERF_TYPE_HARDWARE
+};
+
+static const uint64_t PERF_EVENT_CONFIGS[PERF_EVENTS] = {
+  PERF_COUNT_HW_CPU_CYCLES,
+  PERF_COUNT_HW_INSTRUCTIONS,
+  PERF_COUNT_HW_CACHE_LL | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+  PERF_COUNT_HW_CACHE_DTLB | (PERF_COUNT_HW_CACHE_OP_READ << 8)
+    | (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+  PERF_COUNT_HW_STALLED_CYCLES_BACKEND
+};
+
+//  one counter group, attached to one thread
+struct perfGroup_t {
+  int fds[PERF_EVENTS];  //  -1 for events the CPU does not support
+  pid_t tid;
+};
+typedef struct perfGroup_t perfGroup_t;
+
+//  the counts of one worker over one batch of rounds
+struct perfCounts_t {
+  uint64_t values[PERF_EVENTS];
+  bool available[PERF_EVENTS];
+  pid_t tid;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+typedef struct perfCounts_t perfCounts_t;
+
+//  the counts of the current batch, one slot per worker
+struct perfBatch_t {
+  perfCounts_t counts[MAX_WORKERS];
+  int cntWorkers;
+  int number;  //  batches are numbered from 0 in the order they ran
+};
+typedef struct perfBatch_t perfBatch_t;
+
+static inline perfBatch_t * perfBatch() {
+  static perfBatch_t batch;
+  return &batch;
+}
+
+static inline int perfEventOpen(struct perf_event_attr * const attr, const pid_t tid,
+                                const int groupFd) {
+  return static_cast<int>(syscall(__NR_perf_event_open, attr, tid, -1, groupFd, 0));
+}
+
+//  Opens a disabled counter group on thread tid; false if the
+//  group leader (cycles) cannot be counted at all
+static inline bool openPerfGroup(perfGroup_t * const group, const pid_t tid) {
+  group->tid = tid;
+  for (int i = 0; i < PERF_EVENTS; i++) {
+    struct perf_event_attr attr;
+    memset(&attr, 0, sizeof(attr));
+    attr.size = sizeof(attr);
+    attr.type = PERF_EVENT_TYPES[i];
+    attr.config = PERF_EVENT_CONFIGS[i];
+    attr.disabled = (i == 0);
+    attr.exclude_kernel = 1;
+    attr.exclude_hv = 1;
+    group->fds[i] = perfEventOpen(&attr, tid, (i == 0) ? -1 : group->fds[0]);
+    if ((i == 0) && (group->fds[0] < 0)) {
+      static bool warned = false;
+      if (!warned) {
+        cerr << "WARNING: perf_event_open failed: " << strerror(errno) << endl;
+        warned = true;
+      }
+      return false;
+    }
+  }
+  return true;
+}
+
+static inline void startPerfGroup(perfGroup_t * const group) {
+  ioctl(group->fds[0], PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+  ioctl(group->fds[0], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+}
+
+//  Stops the group and adds its counts to counts
+static inline void stopPerfGroup(perfGroup_t * const group, perfCounts_t * const counts) {
+  ioctl(group->fds[0], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  counts->tid = group->tid;
+  for (int i = 0; i < PERF_EVENTS; i++) {
+    uint64_t value;
+    counts->available[i] = (group->fds[i] >= 0)
+      && (read(group->fds[i], &value, sizeof(value)) == sizeof(value));
+    if (counts->available[i]) {
+      counts->values[i] += value;
+    }
+  }
+}
+
+static inline void closePerfGroup(perfGroup_t * const group) {
+  for (int i = PERF_EVENTS - 1; i >= 0; i--) {
+    if (group->fds[i] >= 0) {
+      close(group->fds[i]);
+    }
+  }
+}
+
+//  D1_NUMA workers are pthreads that live for one call to execute_rounds,
+//  so every worker counts itself from processChunks
+static inline bool startWorkerPerfCounters(perfGroup_t * const group) {
+  if (!openPerfGroup(group, static_cast<pid_t>(syscall(SYS_gettid)))) {
+    return false;
+  }
+  startPerfGroup(group);
+  return true;
+}
+
+static inline void stopWorkerPerfCounters(perfGroup_t * const group, const int worker) {
+  assert(worker < MAX_WORKERS);
+  stopPerfGroup(group, &perfBatch()->counts[worker]);
+  closePerfGroup(group);
+}
+
+//  Everybody else runs execute_rounds on the threads that already exist
+//  (the main thread, plus the Cilk workers in parallel builds), so the
+//  main thread attaches one group to every thread of the process.
+static inline int openProcessPerfGroups(perfGroup_t * const groups) {
+  int cntGroups = 0;
+  DIR * tasks = opendir("/proc/self/task");
+  if (tasks == NULL) {
+    return 0;
+  }
+  struct dirent * task;
+  while (((task = readdir(tasks)) != NULL) && (cntGroups < MAX_WORKERS)) {
+    if (task->d_name[0] == '.') {
+      continue;
+    }
+    if (openPerfGroup(&groups[cntGroups], static_cast<pid_t>(atoi(task->d_name)))) {
+      cntGroups++;
+    }
+  }
+  closedir(tasks);
+  return cntGroups;
+}
+
+static inline perfGroup_t * processPerfGroups() {
+  static perfGroup_t groups[MAX_WORKERS];
+  return groups;
+}
+
+//  Call right before execute_rounds
+static inline void startPerfBatch() {
+  perfBatch_t * batch = perfBatch();
+  memset(batch->counts, 0, sizeof(batch->counts));
+#if D1_NUMA
+  batch->cntWorkers = NUMA_WORKERS;
+#else
+  perfGroup_t * groups = processPerfGroups();
+  batch->cntWorkers = openProcessPerfGroups(groups);
+  for (int i = 0; i < batch->cntWorkers; i++) {
+    startPerfGroup(&groups[i]);
+  }
+#endif
+}
+
+//  Call right after execute_rounds
+static inline void stopPerfBatch() {
+#if !D1_NUMA
+  perfBatch_t * batch = perfBatch();
+  perfGroup_t * groups = processPerfGroups();
+  for (int i = 0; i < batch->cntWorkers; i++) {
+    stopPerfGroup(&groups[i], &batch->counts[i]);
+    closePerfGroup(&groups[i]);
+  }
+#endif
+}
+
+//  Prints one line per worker and one for the whole batch:
+//  PERF, <batch>, <worker>|total, <tid>, <rounds>, <counts...>
+//  Events the CPU does not support are reported as -1.
+static inline void printPerfBatch(const int numRounds) {
+  perfBatch_t * batch = perfBatch();
+  perfCounts_t total;
+  memset(&total, 0, sizeof(total));
+  for (int worker = 0; worker < batch->cntWorkers; worker++) {
+    const perfCounts_t * counts = &batch->counts[worker];
+    cout << "PERF, " << batch->number << ", " << worker << ", "
+         << counts->tid << ", " << numRounds;
+    for (int i = 0; i < PERF_EVENTS; i++) {
+      if (counts->available[i]) {
+        cout << ", " << counts->values[i];
+        total.values[i] += counts->values[i];
+        total.available[i] = true;
+      } else {
+        cout << ", -1";
+      }
+    }
+    cout << '\n';
+  }
+  cout << "PERF, " << batch->number << ", total, 0, " << numRounds;
+  for (int i = 0; i < PERF_EVENTS; i++) {
+    if (total.available[i]) {
+      cout << ", " << total.values[i];
+    } else {
+      cout << ", -1";
+    }
+  }
+  cout << endl;
+  batch->number++;
+}
+
+static inline void printPerfHeader() {
+  cout << "PERF, batch, worker, tid, rounds";
+  for (int i = 0; i < PERF_EVENTS; i++) {
+    cout << ", " << PERF_EVENT_NAMES[i];
+  }
+  cout << endl;
+}
+
+#endif  // PERF_COUNTERS
+
+#endif  // PERF_COUNTERS_H_
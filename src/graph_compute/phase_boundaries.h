@@ -0,0 +1,186 @@
+#ifndef PHASE_BOUNDARIES_H_
+#define PHASE_BOUNDARIES_H_
+
+//  Where the phases of every chunk of 1 << chunkBits vertices end, for
+//  D1_PHASE and D1_NUMA (see chunk_phases.h) and for dag_analyzer and
+//  cache_sim, which model them.  The functions take a view G of the graph
+//  and of the phase boundaries with
+//    vid_t degree(vid_t v) and vid_t edge(vid_t v, vid_t k): the graph
+//    vid_t * phaseEnds(vid_t chunk): the index of the first vertex beyond
+//      each of the cntPhases phases of chunk
+
+#include <cstdint>
+#include <vector>
+#include <algorithm>
+#include "../libgraphio/libgraphio.h"
+
+struct phaseSplit_t {
+  int chunkBits;
+  int cntPhases;
+  int slack;  //  how far a boundary may move from even spacing, in percent of a phase
+};
+typedef struct phaseSplit_t phaseSplit_t;
+
+//  A view of a graph in compressed sparse row form (offsets and edges,
+//  as the offline tools keep it) with the phase ends in a flat array
+template<typename C>
+struct csrPhaseView_t {
+  const C * graph;
+  vid_t * ends;  //  cntPhases entries per chunk
+  int cntPhases;
+  vid_t degree(const vid_t v) const { return graph->offsets[v + 1] - graph->offsets[v]; }
+  vid_t edge(const vid_t v, const vid_t k) const {
+    return graph->edges[graph->offsets[v] + k];
+  }
+  vid_t * phaseEnds(const vid_t chunk) const { return ends + chunk * cntPhases; }
+};
+
+//  Gives up moving the boundaries after this many passes over all chunks
+static const int MAX_PHASE_BOUNDARY_PASSES = 8;
+
+//  The phase of v, given the phase ends of its chunk
+static inline int phaseIn(const vid_t * const phaseEnds, const vid_t v) {
+  int phase = 0;
+  while (v >= phaseEnds[phase]) {
+    phase++;
+  }
+  return phase;
+}
+
+template<typename G>
+static inline int phaseOf(const G& view, const phaseSplit_t& split, const vid_t v) {
+  return phaseIn(view.phaseEnds(v >> split.chunkBits), v);
+}
+
+//  The neighbors of v in other chunks that are in phase
+template<typename G>
+static inline vid_t crossChunkNeighborsInPhase(const G& view, const phaseSplit_t& split,
+                                               const vid_t v, const int phase) {
+  vid_t cntNeighbors = 0;
+  for (vid_t k = 0; k < view.degree(v); k++) {
+    const vid_t w = view.edge(v, k);
+    if (((v >> split.chunkBits) != (w >> split.chunkBits))
+        && (phaseOf(view, split, w) == phase)) {
+      cntNeighbors++;
+    }
+  }
+  return cntNeighbors;
+}
+
+static inline vid_t cntChunksOf(const phaseSplit_t& split, const vid_t cntNodes) {
+  return (cntNodes + (static_cast<vid_t>(1) << split.chunkBits) - 1) >> split.chunkBits;
+}
+
+//  The first vertex beyond phase of chunk, if the phases were the same size
+static inline vid_t evenPhaseEnd(const phaseSplit_t& split, const vid_t chunk,
+                                 const int phase) {
+  const int64_t chunkSize = static_cast<int64_t>(1) << split.chunkBits;
+  return (chunk << split.chunkBits)
+    + static_cast<vid_t>(chunkSize * (phase + 1) / split.cntPhases);
+}
+
+template<typename G>
+static inline void spacePhasesEvenly(const G& view, const phaseSplit_t& split,
+                                     const vid_t cntNodes) {
+  const vid_t cntChunks = cntChunksOf(split, cntNodes);
+  for (vid_t chunk = 0; chunk < cntChunks; chunk++) {
+    vid_t * const phaseEnds = view.phaseEnds(chunk);
+    for (int phase = 0; phase < split.cntPhases; phase++) {
+      phaseEnds[phase] = std::min(evenPhaseEnd(split, chunk, phase), cntNodes);
+    }
+  }
+}
+
+//  Edges between different chunks in the same phase: each one is an
+//  inter-chunk dependency with distance 1
+template<typename G>
+static inline uint64_t samePhaseCrossChunkEdges(const G& view, const phaseSplit_t& split,
+                                                const vid_t cntNodes) {
+  const vid_t cntChunks = cntChunksOf(split, cntNodes);
+  std::vector<uint64_t> cntEdges(cntChunks, 0);
+  cilk_for (vid_t chunk = 0; chunk < cntChunks; chunk++) {
+    const vid_t end = std::min((chunk + 1) << split.chunkBits, cntNodes);
+    for (vid_t v = chunk << split.chunkBits; v < end; v++) {
+      cntEdges[chunk] += crossChunkNeighborsInPhase(view, split, v,
+                                                    phaseOf(view, split, v));
+    }
+  }
+  uint64_t total = 0;
+  for (vid_t chunk = 0; chunk < cntChunks; chunk++) {
+    total += cntEdges[chunk];
+  }
+  return total / 2;
+}
+
+//  Moves the boundary between phase and phase + 1 of a chunk to where the
+//  fewest edges of the vertices that could change phase end up in the
+//  same phase as their neighbor in another chunk, the other chunks'
+//  boundaries being fixed.  Returns true if it moved the boundary.
+template<typename G>
+static inline bool moveBoundary(const G& view, const phaseSplit_t& split,
+                                const vid_t chunk, const int phase) {
+  const vid_t chunkSize = static_cast<vid_t>(1) << split.chunkBits;
+  const vid_t slack = (chunkSize / split.cntPhases) * split.slack / 100;
+  vid_t * const phaseEnds = view.phaseEnds(chunk);
+  const vid_t first = chunk << split.chunkBits;
+  const vid_t even = evenPhaseEnd(split, chunk, phase);
+  //  neither phase may become empty
+  const vid_t begin = std::max(even - std::min(slack, even),
+                               ((phase > 0) ? phaseEnds[phase - 1] : first) + 1);
+  const vid_t end = std::min(even + slack, phaseEnds[phase + 1] - 1);
+  if ((begin >= end) || (phaseEnds[phase] < begin) || (phaseEnds[phase] > end)) {
+    return false;
+  }
+  //  cost of putting the boundary at end, minus that of putting it at begin
+  int64_t cost = 0;
+  int64_t bestCost = 0;
+  int64_t currentCost = 0;
+  vid_t bestIndex = begin;
+  for (vid_t v = begin; v < end; v++) {
+    cost += static_cast<int64_t>(crossChunkNeighborsInPhase(view, split, v, phase))
+          - crossChunkNeighborsInPhase(view, split, v, phase + 1);
+    if (cost < bestCost) {
+      bestCost = cost;
+      bestIndex = v + 1;
+    }
+    if (v + 1 == phaseEnds[phase]) {
+      currentCost = cost;
+    }
+  }
+  //  only move if it strictly helps, so that the passes come to an end
+  if ((bestCost < currentCost) && (bestIndex != phaseEnds[phase])) {
+    phaseEnds[phase] = bestIndex;
+    return true;
+  }
+  return false;
+}
+
+//  Greedily moves each boundary in turn, starting from evenly spaced
+//  phases, to cut the edges between chunks that fall in the same phase,
+//  until no boundary moves.  Every move lowers that count.  The passes
+//  are serial on purpose: every move sees the moves before it, which
+//  moving all chunks at once against the last pass's boundaries does not,
+//  and that cuts markedly fewer edges.  Returns the number of passes over
+//  all chunks.
+template<typename G>
+static inline int movePhaseBoundaries(const G& view, const phaseSplit_t& split,
+                                      const vid_t cntNodes) {
+  if ((split.cntPhases == 1) || (split.slack == 0)) {
+    return 0;
+  }
+  const vid_t cntChunks = cntChunksOf(split, cntNodes);
+  int pass = 0;
+  bool moved = true;
+  while (moved && (pass < MAX_PHASE_BOUNDARY_PASSES)) {
+    moved = false;
+    for (vid_t chunk = 0; chunk < cntChunks; chunk++) {
+      for (int phase = 0; phase + 1 < split.cntPhases; phase++) {
+        moved |= moveBoundary(view, split, chunk, phase);
+      }
+    }
+    pass++;
+  }
+  return pass;
+}
+
+#endif  // PHASE_BOUNDARIES_H_
@@ -4,9 +4,10 @@
 #if D1_PHASE
 
 #include <algorithm>
-#include <unordered_set>
 #include "./common.h"
 #include "./numa_init.h"
+#include "./chunk_trace.h"
+#include "./memory_accounting.h"
 
 #ifndef CHUNK_BITS
   #define CHUNK_BITS 16
@@ -28,11 +29,13 @@ typedef struct sched_t sched_t;
 
 // there is one of these per chunk
 struct chunkdata_t {
-  vid_t phaseEndIndex[2];  // the index of the first vertex beyond this chunk
+  vid_t phaseEndIndex[NUM_PHASES];  // the index of the first vertex beyond each phase
   vid_t nextIndex;  // the next vertex in this chunk to be processed
 };
 typedef struct chunkdata_t chunkdata_t;
 
+#include "./chunk_phases.h"
+
 struct scheddata_t {
   //  dependentEdges holds the dependent edges array,
   //  one entry per inter-chunk dependency
@@ -44,93 +47,16 @@ struct scheddata_t {
 };
 typedef struct scheddata_t scheddata_t;
 
-static inline bool samePhase(vid_t v, vid_t w, chunkdata_t * const chunkdata) {
-  // this assumes that the boundary between phases is the
-  // midpoint of the chunk - we will generalize later
-  // to a custom boundary to optimize overall work
-  bool vPhase = v < chunkdata[v >> CHUNK_BITS].phaseEndIndex[0];
-  bool wPhase = w < chunkdata[w >> CHUNK_BITS].phaseEndIndex[0];
-  return (vPhase == wPhase);
-}
-
-static inline bool interChunkDependency(vid_t v, vid_t w) {
-  static const vid_t chunkMask = (1 << CHUNK_BITS) - 1;
-  if ((v >> CHUNK_BITS) == (w >> CHUNK_BITS)) {
-    return false;
-  } else if ((v & chunkMask) == (w & chunkMask)) {
-    return (v < w);
-  } else {
-    return ((v & chunkMask) < (w & chunkMask));
-  }
-}
-
-static inline void calculateNeighborhood(std::unordered_set<vid_t> * neighbors,
-                                         std::unordered_set<vid_t> * oldNeighbors,
-                                         vid_t v,
-                                         vertex_t * const nodes,
-                                         vid_t distance) {
-  neighbors->clear();
-  neighbors->insert(v);
-  oldNeighbors->clear();
-  for (vid_t d = 0; d < distance; d++) {
-    *oldNeighbors = *neighbors;
-    for (const auto& v : *oldNeighbors) {
-      for (vid_t j = 0; j < nodes[v].cntEdges; j++) {
-        if (oldNeighbors->count(nodes[v].edges[j]) == 0) {
-          neighbors->insert(nodes[v].edges[j]);
-        }
-      }
-    }
-  }
-}
-
 static inline void calculateNodeDependenciesChunk(vertex_t * const nodes,
                                                   const vid_t cntNodes,
                                                   scheddata_t * const scheddata) {
-  vid_t * dependentEdgeIndex = new (std::nothrow) vid_t[cntNodes]();
-  vid_t cntDependencies = 0;
-  std::unordered_set<vid_t> neighbors;
-  neighbors.reserve(1024);
-  std::unordered_set<vid_t> oldNeighbors;
-  oldNeighbors.reserve(1024);
-  for (vid_t i = 0; i < cntNodes; i++) {
-    calculateNeighborhood(&neighbors, &oldNeighbors, i, nodes, DISTANCE);
-    dependentEdgeIndex[i] = cntDependencies;
-    sched_t * node = &nodes[i].sched;
-    node->dependencies = 0;
-    node->cntDependentEdges = 0;
-    for (const auto& neighbor : neighbors) {
-      if (samePhase(neighbor, i, scheddata->chunkdata)) {
-        if (interChunkDependency(neighbor, i)) {
-          node->dependencies++;
-        } else if (interChunkDependency(i, neighbor)) {
-          cntDependencies++;
-          node->cntDependentEdges++;
-        }
-      }
-    }
-    node->satisfied = node->dependencies;
-  }
+  //  only reported in TEST mode, as D1_NUMA does
+  const vid_t cntDependencies __attribute__((unused)) = calculatePhaseDependencies(
+    nodes, cntNodes, scheddata->chunkdata, &scheddata->dependentEdges);
   WHEN_TEST({
   printf("InterChunkDependencies: %lu\n",
     static_cast<uint64_t>(cntDependencies));
   })
-  numaInit_t numaInit(NUMA_WORKERS,
-                      CHUNK_BITS, static_cast<bool>(NUMA_INIT));
-  scheddata->dependentEdges =
-    static_cast<vid_t *>(numaCalloc(numaInit, sizeof(vid_t), cntDependencies+1));
-  for (vid_t i = 0; i < cntNodes; i++) {
-    nodes[i].sched.dependentEdges = &scheddata->dependentEdges[dependentEdgeIndex[i]];
-    calculateNeighborhood(&neighbors, &oldNeighbors, i, nodes, DISTANCE);
-    vid_t curIndex = dependentEdgeIndex[i];
-    for (const auto& neighbor : neighbors) {
-      if ((samePhase(neighbor, i, scheddata->chunkdata))
-        && (interChunkDependency(i, neighbor))) {
-          scheddata->dependentEdges[curIndex++] = neighbor;
-      }
-    }
-  }
-  delete[] dependentEdgeIndex;
 }
 
 static inline void createChunkData(vertex_t * const nodes,
@@ -139,16 +65,14 @@ static inline void createChunkData(vertex_t * const nodes,
   scheddata->cntChunks = (cntNodes + (1 << CHUNK_BITS) - 1) >> CHUNK_BITS;
   scheddata->chunkdata = new (std::nothrow) chunkdata_t[scheddata->cntChunks]();
   assert(scheddata->chunkdata != NULL);
+  trackAllocation("chunkdata", scheddata->chunkdata,
+                  sizeof(chunkdata_t) * scheddata->cntChunks);
 
   cilk_for (vid_t i = 0; i < scheddata->cntChunks; ++i) {
     chunkdata_t * chunk = &scheddata->chunkdata[i];
     chunk->nextIndex = i << CHUNK_BITS;
-    chunk->phaseEndIndex[0] = std::min(chunk->nextIndex + (1 << (CHUNK_BITS - 1)),
-      cntNodes);
-    chunk->phaseEndIndex[1] = std::min((i + 1) << CHUNK_BITS, cntNodes);
-    // put code to greedily move boundaryIndex to minimize cost of
-    // interChunk dependencies here
   }
+  createPhaseBoundaries(nodes, cntNodes, scheddata->chunkdata);
 }
 
 static inline void init_scheduling(vertex_t * const nodes,
@@ -173,14 +97,20 @@ static inline void execute_rounds(const int numRounds,
       scheddata->chunkdata[i].nextIndex = i << CHUNK_BITS;
     }
 
-    const int NUM_PHASES = 2;
     for (int phase = 0; phase < NUM_PHASES; phase++) {
       volatile bool doneFlag = false;
       while (!doneFlag) {
         doneFlag = true;
+      #if CHUNK_TRACE
+        const uint64_t passStart = readCycleCounter();
+      #endif
         cilk_for (vid_t i = 0; i < scheddata->cntChunks; i++) {
           chunkdata_t * chunk = &scheddata->chunkdata[i];
           vid_t j = chunk->nextIndex;
+        #if CHUNK_TRACE
+          const vid_t firstIndex = j;
+          const uint64_t chunkStart = readCycleCounter();
+        #endif
           bool localDoneFlag = false;
           while (!localDoneFlag && (j < chunk->phaseEndIndex[phase])) {
             if (nodes[j].sched.satisfied == 0) {
@@ -205,7 +135,17 @@ static inline void execute_rounds(const int numRounds,
           if (!localDoneFlag) {
             scheddata->chunkdata[i].nextIndex = j;
           }
+        #if CHUNK_TRACE
+          //  chunks finished in an earlier pass are not worth an event
+          if (firstIndex < chunk->phaseEndIndex[phase]) {
+            traceChunk(chunkStart, i, chunk->nextIndex - firstIndex,
+                       round, phase, localDoneFlag ? TRACE_SHELVED : 0);
+          }
+        #endif
         }
+      #if CHUNK_TRACE
+        traceInterval(TRACE_PASS, passStart, readCycleCounter(), round, phase);
+      #endif
       }
     }
   }
@@ -214,12 +154,17 @@ static inline void execute_rounds(const int numRounds,
 static inline void cleanup_scheduling(vertex_t * const nodes,
                                       const vid_t cntNodes,
                                       scheddata_t * const scheddata) {
+#if CHUNK_TRACE
+  writeChunkTrace();
+#endif
   delete[] scheddata->chunkdata;
-  delete[] scheddata->dependentEdges;
+  //  from numaCalloc
+  free(scheddata->dependentEdges);
 }
 
 static inline void print_execution_data() {
   cout << "Chunk size bits: " << CHUNK_BITS << '\n';
+  cout << "Phases: " << NUM_PHASES << '\n';
 }
 
 #endif  // D1_PHASE
@@ -3,9 +3,14 @@
 
 #if D1_PRIO || BASELINE
 
+#include <cstdlib>
 #include <vector>
+#include <random>
+#include <numeric>
 #include <algorithm>
 #include "./common.h"
+#include "./reduction.h"
+#include "./memory_accounting.h"
 
 #if BASELINE
   #ifndef PRIORITY_GROUP_BITS
@@ -17,16 +22,55 @@
   #define PRIORITY_GROUP_BITS 8
 #endif
 
-#define MAX_REC_DEPTH 10
+//  the values of PRIORITY_POLICY
+#define PRIORITY_ROTATED 0
+#define PRIORITY_HASH 1
+#define PRIORITY_DEGREE 2
+#define PRIORITY_CHUNK 3
+#define PRIORITY_RANDOM 4
+
+#if PRIORITY_POLICY == PRIORITY_ROTATED
+  #define PRIORITY_POLICY_NAME "rotated"
+#elif PRIORITY_POLICY == PRIORITY_HASH
+  #define PRIORITY_POLICY_NAME "hash"
+#elif PRIORITY_POLICY == PRIORITY_DEGREE
+  #define PRIORITY_POLICY_NAME "degree"
+#elif PRIORITY_POLICY == PRIORITY_CHUNK
+  #define PRIORITY_POLICY_NAME "chunk"
+  #if CHUNK_BITS == 0
+    #error "PRIORITY_POLICY=3 needs CHUNK_BITS"
+  #endif
+#elif PRIORITY_POLICY == PRIORITY_RANDOM
+  #define PRIORITY_POLICY_NAME "random"
+#else
+  #error "Unknown PRIORITY_POLICY"
+#endif
+
+//  A worker's vertices that are ready to be updated.  The owner pushes and
+//  pops at the bottom, so it goes on with the vertices it just made ready,
+//  while thieves take the oldest ones from the top.  Every operation takes
+//  the lock, which is rarely contended, since thieves only come looking
+//  once they have run out of work.
+struct readyDeque_t {
+  vid_t * items;
+  vid_t capacity;
+  volatile vid_t top;
+  volatile vid_t bottom;
+  volatile int lock;
+};
+typedef struct readyDeque_t readyDeque_t;
 
 struct scheddata_t {
   vid_t * roots;
   vid_t cntRoots;
+  padded_t<readyDeque_t> * deques;  //  one per worker
+  int cntDeques;
+  volatile vid_t cntProcessed;  //  vertices updated this round
 };
 typedef struct scheddata_t scheddata_t;
 
 struct sched_t {
-  vid_t id;
+  vid_t cntSuccessors;  //  edges[0, cntSuccessors) point to higher priorities
   vid_t priority;
   vid_t dependencies;
   volatile vid_t satisfied;
@@ -35,73 +79,144 @@ typedef struct sched_t sched_t;
 
 #include "./update_function.h"
 
-// we need this processNodeSerial hack to avoid a Cilk bug when trying to do
-// spawn depth limiting (which in turn is necessary because otherwise on large problem
-// sizes worker stacks are overflowed)
-static inline void processNodeSerial(vertex_t * const nodes,
-                                     const vid_t index,
-                                     const vid_t cntNodes,
-                                     global_t * const globaldata,
-                                     const int round) {
-  update(nodes, index, globaldata, round);
-  vertex_t * current = &nodes[index];
+static const vid_t NO_VERTEX = static_cast<vid_t>(-1);
 
-  // increment the dependencies for all nodes of greater priority
-  for (vid_t i = 0; i < current->cntEdges; ++i) {
-    vid_t neighborId = current->edges[i];
-    sched_t * neighbor = &nodes[neighborId].sched;
-    if (neighbor->priority > current->sched.priority) {
-      if (__sync_sub_and_fetch(&neighbor->satisfied, 1) == 0) {
-        neighbor->satisfied = neighbor->dependencies;
-        processNodeSerial(nodes, neighborId, cntNodes, globaldata, round);
+static inline void lockDeque(readyDeque_t * const deque) {
+  while (__sync_lock_test_and_set(&deque->lock, 1) == 1) {
+    while (deque->lock == 1) {}
+  }
+}
+
+static inline void pushReady(readyDeque_t * const deque, const vid_t index) {
+  lockDeque(deque);
+  if (deque->bottom == deque->capacity) {
+    //  move the items down if thieves have freed enough space at the top,
+    //  and grow the deque otherwise
+    const vid_t cntItems = deque->bottom - deque->top;
+    vid_t * items = deque->items;
+    if (2 * cntItems >= deque->capacity) {
+      deque->capacity = std::max(2 * deque->capacity, static_cast<vid_t>(64));
+      items = new (std::nothrow) vid_t[deque->capacity];
+      assert(items != NULL);
+    }
+    std::copy(deque->items + deque->top, deque->items + deque->bottom, items);
+    if (items != deque->items) {
+      delete[] deque->items;
+      deque->items = items;
+    }
+    deque->top = 0;
+    deque->bottom = cntItems;
+  }
+  deque->items[deque->bottom] = index;
+  deque->bottom++;
+  __sync_lock_release(&deque->lock);
+}
+
+//  Takes the newest vertex if fromBottom, the oldest one otherwise
+static inline vid_t popReady(readyDeque_t * const deque, const bool fromBottom) {
+  if (deque->top == deque->bottom) {
+    return NO_VERTEX;
+  }
+  lockDeque(deque);
+  vid_t index = NO_VERTEX;
+  if (deque->top != deque->bottom) {
+    if (fromBottom) {
+      deque->bottom--;
+      index = deque->items[deque->bottom];
+    } else {
+      index = deque->items[deque->top];
+      deque->top++;
+    }
+    if (deque->top == deque->bottom) {
+      deque->top = deque->bottom = 0;
+    }
+  }
+  __sync_lock_release(&deque->lock);
+  return index;
+}
+
+//  Tries every other worker's deque once, starting at a random one
+static inline vid_t stealReady(scheddata_t * const scheddata, const int self,
+                               victimPicker_t * const picker) {
+  const int start = picker->next(scheddata->cntDeques);
+  for (int i = 0; i < scheddata->cntDeques; i++) {
+    const int victim = (start + i) % scheddata->cntDeques;
+    if (victim != self) {
+      const vid_t index = popReady(&scheddata->deques[victim].value, false);
+      if (index != NO_VERTEX) {
+        return index;
       }
     }
   }
+  return NO_VERTEX;
 }
 
-static inline void processNode(vertex_t * const nodes,
-                               const vid_t index,
-                               const vid_t cntNodes,
-                               const int depth,
-                               global_t * const globaldata,
-                               const int round) {
+//  Updates a vertex and counts down the dependencies of its successors.
+//  Returns the first successor that became ready, to be updated next
+//  without going through the deque, and pushes any others.
+static inline vid_t processNode(vertex_t * const nodes,
+                                const vid_t index,
+                                global_t * const globaldata,
+                                const int round,
+                                readyDeque_t * const deque) {
   update(nodes, index, globaldata, round);
   vertex_t * current = &nodes[index];
+  vid_t next = NO_VERTEX;
 
-  // increment the dependencies for all nodes of greater priority
-  for (vid_t i = 0; i < current->cntEdges; ++i) {
+  // decrement the dependencies for all nodes of greater priority
+  for (vid_t i = 0; i < current->sched.cntSuccessors; ++i) {
     vid_t neighborId = current->edges[i];
     sched_t * neighbor = &nodes[neighborId].sched;
-    if (neighbor->priority > current->sched.priority) {
-      if (__sync_sub_and_fetch(&neighbor->satisfied, 1) == 0) {
-        neighbor->satisfied = neighbor->dependencies;
-        if (depth < MAX_REC_DEPTH) {
-          cilk_spawn processNode(nodes, neighborId, cntNodes,
-                                 depth + 1, globaldata, round);
-        } else {
-          processNodeSerial(nodes, neighborId, cntNodes, globaldata, round);
-        }
+    if (__sync_sub_and_fetch(&neighbor->satisfied, 1) == 0) {
+      neighbor->satisfied = neighbor->dependencies;
+      if (next == NO_VERTEX) {
+        next = neighborId;
+      } else {
+        pushReady(deque, neighborId);
       }
-    } else {
-      break;
     }
   }
-  cilk_sync;
+  return next;
 }
 
+//  Updates index and then the chain of successors it makes ready, in a
+//  loop, so the stack does not grow with the length of a dependency
+//  chain.  Returns the number of vertices updated.
+static inline vid_t processChain(vertex_t * const nodes, vid_t index,
+                                 global_t * const globaldata, const int round,
+                                 readyDeque_t * const deque) {
+  vid_t cntProcessed = 0;
+  while (index != NO_VERTEX) {
+    index = processNode(nodes, index, globaldata, round, deque);
+    cntProcessed++;
+  }
+  return cntProcessed;
+}
+
+//  Every edge after the successors points to a lower priority, and so is
+//  a dependency, unless it is a self-loop.  Needs orderEdgesByPriority.
 static inline void calculateNodeDependencies(vertex_t * const nodes,
                                              const vid_t cntNodes) {
   cilk_for (vid_t i = 0; i < cntNodes; ++i) {
-    nodes[i].sched.id = i;
     nodes[i].sched.dependencies = 0;
-    for (vid_t j = 0; j < nodes[i].cntEdges; ++j) {
-      sched_t * neighbor = &nodes[nodes[i].edges[j]].sched;
-      if (nodes[i].sched.priority > neighbor->priority) {
+    for (vid_t j = nodes[i].sched.cntSuccessors; j < nodes[i].cntEdges; ++j) {
+      if (nodes[i].edges[j] != i) {
         ++nodes[i].sched.dependencies;
       }
     }
     nodes[i].sched.satisfied = nodes[i].sched.dependencies;
   }
+  WHEN_TEST({
+    for (vid_t i = 0; i < cntNodes; ++i) {
+      vid_t dependencies = 0;
+      for (vid_t j = 0; j < nodes[i].cntEdges; ++j) {
+        if (nodes[i].sched.priority > nodes[nodes[i].edges[j]].sched.priority) {
+          ++dependencies;
+        }
+      }
+      assert(dependencies == nodes[i].sched.dependencies);
+    }
+  })
 }
 
 static inline int calculateIdBitSize(const uint64_t cntNodes) {
@@ -116,8 +231,17 @@ static inline int calculateIdBitSize(const uint64_t cntNodes) {
 }
 
 static inline vid_t createPriority(const vid_t id, const int bitsInId) {
-#if USE_RANDOM_PRIORITY_HASH
+#if PRIORITY_POLICY == PRIORITY_HASH
   return id*static_cast<vid_t>(2654435761);
+#elif PRIORITY_POLICY == PRIORITY_CHUNK
+  if (bitsInId <= CHUNK_BITS) {
+    return id;
+  }
+
+  // the offset within the chunk becomes the top of the priority, so
+  // vertices at the same offset in all chunks can run at the same time
+  vid_t offsetMask = (static_cast<vid_t>(1) << CHUNK_BITS) - 1;
+  return ((id & offsetMask) << (bitsInId - CHUNK_BITS)) | (id >> CHUNK_BITS);
 #else
   vid_t priority;
 
@@ -136,24 +260,60 @@ static inline vid_t createPriority(const vid_t id, const int bitsInId) {
 #endif
 }
 
+#if PRIORITY_POLICY == PRIORITY_RANDOM
+static inline uint64_t readPrioritySeed() {
+  const char * seed = getenv("PRIORITY_SEED");
+  if (seed != NULL) {
+    return strtoull(seed, NULL, 10);
+  }
+  std::random_device device;
+  return (static_cast<uint64_t>(device()) << 32) | device();
+}
+
+//  the same for the whole run, so that it can be printed at the end
+static inline uint64_t prioritySeed() {
+  static const uint64_t seed = readPrioritySeed();
+  return seed;
+}
+#endif
+
 static inline void assignNodePriorities(vertex_t * const nodes,
                                         const vid_t cntNodes,
                                         const int bitsInId) {
+#if (PRIORITY_POLICY == PRIORITY_DEGREE) || (PRIORITY_POLICY == PRIORITY_RANDOM)
+  //  these policies rank the vertices, and a vertex's rank is its priority
+  std::vector<vid_t> order(cntNodes);
+  std::iota(order.begin(), order.end(), 0);
+  #if PRIORITY_POLICY == PRIORITY_DEGREE
+    //  high degree vertices go first, since they have the most neighbors
+    //  waiting on them
+    std::stable_sort(order.begin(), order.end(), [nodes](const vid_t a, const vid_t b) {
+      return nodes[a].cntEdges > nodes[b].cntEdges;
+    });
+  #else
+    std::mt19937_64 generator(prioritySeed());
+    std::shuffle(order.begin(), order.end(), generator);
+  #endif
+  cilk_for (vid_t rank = 0; rank < cntNodes; ++rank) {
+    nodes[order[rank]].sched.priority = rank;
+  }
+#else
   cilk_for (vid_t i = 0; i < cntNodes; ++i) {
-    nodes[i].sched.id = i;
-    nodes[i].sched.priority = createPriority(nodes[i].sched.id, bitsInId);
+    nodes[i].sched.priority = createPriority(i, bitsInId);
+  }
+#endif
 
-    WHEN_DEBUG({
-      cout << "Node ID " << nodes[i].sched.id
+  WHEN_DEBUG({
+    for (vid_t i = 0; i < cntNodes; ++i) {
+      cout << "Node ID " << i
            << " got priority " << nodes[i].sched.priority << '\n';
-    })
-  }
+    }
+  })
 
   WHEN_TEST({
-    // ensure no two nodes have the same ID or priority
+    // ensure no two nodes have the same priority
     for (vid_t i = 0; i < cntNodes; ++i) {
       for (vid_t j = i + 1; j < cntNodes; ++j) {
-        assert(nodes[i].sched.id != nodes[j].sched.id);
         assert(nodes[i].sched.priority != nodes[j].sched.priority);
       }
     }
@@ -161,34 +321,72 @@ static inline void assignNodePriorities(vertex_t * const nodes,
 }
 
 // for each vertex, move its successors (by priority) to the front of the edges list
+// and remember how many there are
 static inline void orderEdgesByPriority(vertex_t * const nodes, const vid_t cntNodes) {
   cilk_for (vid_t i = 0; i < cntNodes; ++i) {
-    std::stable_partition(nodes[i].edges, nodes[i].edges + nodes[i].cntEdges,
-      [nodes, i](const vid_t& val) {
-        return (nodes[i].sched.priority < nodes[val].sched.priority);
-      });
+    vid_t * firstPredecessor =
+      std::stable_partition(nodes[i].edges, nodes[i].edges + nodes[i].cntEdges,
+        [nodes, i](const vid_t& val) {
+          return (nodes[i].sched.priority < nodes[val].sched.priority);
+        });
+    nodes[i].sched.cntSuccessors = firstPredecessor - nodes[i].edges;
   }
 }
 
 static inline void findRoots(vertex_t * const nodes,
                              const vid_t cntNodes,
                              scheddata_t * const scheddata) {
-  scheddata->cntRoots = 0;
-  for (vid_t i = 0; i < cntNodes; ++i) {
-    if (nodes[i].sched.dependencies == 0) {
-      ++scheddata->cntRoots;
-    }
-  }
+  scheddata->roots = parallelFilter(cntNodes, [nodes](const vid_t i) {
+    return (nodes[i].sched.dependencies == 0);
+  }, &scheddata->cntRoots);
+  trackAllocation("roots", scheddata->roots, sizeof(vid_t) * scheddata->cntRoots);
+}
 
-  scheddata->roots = new (std::nothrow) vid_t[scheddata->cntRoots];
-  assert(scheddata->roots != NULL);
+struct dagStats_t {
+  vid_t depth;  //  vertices on the longest dependency chain
+  vid_t width;  //  vertices on the widest level
+  double parallelism;  //  vertices per level, on average
+};
+typedef struct dagStats_t dagStats_t;
 
-  vid_t position = 0;
-  for (vid_t i = 0; i < cntNodes; ++i) {
-    if (nodes[i].sched.dependencies == 0) {
-      scheddata->roots[position++] = i;
+static inline dagStats_t * dagStats() {
+  static dagStats_t stats;
+  return &stats;
+}
+
+//  Walks the dependency DAG level by level: the roots, then the vertices
+//  whose last dependency is on the previous level, and so on.
+static inline void calculateDagStats(vertex_t * const nodes,
+                                     const vid_t cntNodes,
+                                     const scheddata_t * const scheddata) {
+  vid_t * remaining = new (std::nothrow) vid_t[cntNodes];
+  assert(remaining != NULL);
+  cilk_for (vid_t i = 0; i < cntNodes; ++i) {
+    remaining[i] = nodes[i].sched.dependencies;
+  }
+  std::vector<vid_t> level(scheddata->roots, scheddata->roots + scheddata->cntRoots);
+  std::vector<vid_t> nextLevel;
+  dagStats_t * stats = dagStats();
+  stats->depth = 0;
+  stats->width = 0;
+  vid_t cntVisited = 0;
+  while (!level.empty()) {
+    stats->depth++;
+    stats->width = std::max(stats->width, static_cast<vid_t>(level.size()));
+    cntVisited += level.size();
+    nextLevel.clear();
+    for (const vid_t v : level) {
+      for (vid_t i = 0; i < nodes[v].sched.cntSuccessors; ++i) {
+        if (--remaining[nodes[v].edges[i]] == 0) {
+          nextLevel.push_back(nodes[v].edges[i]);
+        }
+      }
     }
+    level.swap(nextLevel);
   }
+  assert(cntVisited == cntNodes);
+  stats->parallelism = static_cast<double>(cntNodes) / std::max(stats->depth, vid_t(1));
+  delete[] remaining;
 }
 
 static inline void init_scheduling(vertex_t * const nodes,
@@ -200,6 +398,13 @@ static inline void init_scheduling(vertex_t * const nodes,
   orderEdgesByPriority(nodes, cntNodes);
   calculateNodeDependencies(nodes, cntNodes);
   findRoots(nodes, cntNodes, scheddata);
+#if VERBOSE
+  calculateDagStats(nodes, cntNodes, scheddata);
+#endif
+  scheddata->cntDeques = getMaxWorkers();
+  scheddata->deques = allocatePadded<readyDeque_t>(scheddata->cntDeques);
+  trackAllocation("deques", scheddata->deques,
+                  sizeof(padded_t<readyDeque_t>) * scheddata->cntDeques);
 }
 
 static inline void execute_rounds(const int numRounds,
@@ -212,9 +417,28 @@ static inline void execute_rounds(const int numRounds,
     WHEN_DEBUG({
       cout << "Running d1 prio round " << round << endl;
     })
-    cilk_for (vid_t i = 0; i < scheddata->cntRoots; ++i) {
-      processNode(nodes, scheddata->roots[i], cntNodes, 0, globaldata, round);
-    }
+    scheddata->cntProcessed = 0;
+    //  the roots are dealt out backwards, so that the owner pops them in
+    //  order; the round is over once every vertex has been updated
+    const int cntDeques = scheddata->cntDeques;
+    runWorkStealingRound(cntDeques, NO_VERTEX, [scheddata, cntDeques](const int w) {
+      const vid_t begin = scheddata->cntRoots * w / cntDeques;
+      for (vid_t i = scheddata->cntRoots * (w + 1) / cntDeques; i > begin; --i) {
+        pushReady(&scheddata->deques[w].value, scheddata->roots[i - 1]);
+      }
+    }, [scheddata](const int w) {
+      return popReady(&scheddata->deques[w].value, true);
+    }, [scheddata](const int w, victimPicker_t * const picker) {
+      return stealReady(scheddata, w, picker);
+    }, [nodes, scheddata, globaldata, round](const int w, const vid_t index,
+                                             const bool stolen) {
+      return processChain(nodes, index, globaldata, round, &scheddata->deques[w].value);
+    }, [scheddata, cntNodes](const vid_t cntProcessed) {
+      if (cntProcessed > 0) {
+        __sync_fetch_and_add(&scheddata->cntProcessed, cntProcessed);
+      }
+      return (scheddata->cntProcessed == cntNodes);
+    });
   }
 }
 
@@ -222,10 +446,24 @@ static inline void cleanup_scheduling(vertex_t * const nodes,
                                       const vid_t cntNodes,
                                       scheddata_t * const scheddata) {
   delete[] scheddata->roots;
+  for (int w = 0; w < scheddata->cntDeques; ++w) {
+    delete[] scheddata->deques[w].value.items;
+  }
+  freePadded(scheddata->deques);
 }
 
 static inline void print_execution_data() {
+  cout << "Priority policy: " << PRIORITY_POLICY_NAME << '\n';
   cout << "Priority group bits: " << PRIORITY_GROUP_BITS << '\n';
+#if PRIORITY_POLICY == PRIORITY_RANDOM
+  cout << "Priority seed: " << prioritySeed() << '\n';
+#endif
+#if VERBOSE
+  cout << "DAG depth: " << dagStats()->depth << '\n';
+  cout << "DAG width: " << dagStats()->width << '\n';
+  cout << "DAG average parallelism: " << dagStats()->parallelism << '\n';
+#endif
+  cout << "Ready deques: " << getMaxWorkers() << '\n';
 }
 
 #endif  // D1_PRIO || BASELINE
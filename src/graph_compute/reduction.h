@@ -0,0 +1,317 @@
+#ifndef REDUCTION_H_
+#define REDUCTION_H_
+
+#include <stdlib.h>
+#include <cstring>
+#include <algorithm>
+#include <new>
+#include "./common.h"
+
+//  upper bound on the number of workers owning a per-worker accumulator
+#ifndef MAX_WORKERS
+  #define MAX_WORKERS 256
+#endif
+
+//  parallelSum adds up blocks of 2^REDUCTION_BLOCK_BITS items serially
+#ifndef REDUCTION_BLOCK_BITS
+  #define REDUCTION_BLOCK_BITS 12
+#endif
+
+static const vid_t REDUCTION_BLOCK_SIZE = static_cast<vid_t>(1) << REDUCTION_BLOCK_BITS;
+
+//  A value padded to whole cache lines, so that workers writing
+//  neighbouring slots of an array do not false-share.
+template<typename T>
+struct padded_t {
+  T value;
+} __attribute__((aligned(CACHE_LINE_SIZE)));
+
+//  new[] does not honour over-aligned types before C++17
+template<typename T>
+static inline padded_t<T> * allocatePadded(const size_t cntSlots) {
+  void * slots = NULL;
+  const size_t numBytes = std::max(cntSlots, static_cast<size_t>(1))*sizeof(padded_t<T>);
+  int result = posix_memalign(&slots, CACHE_LINE_SIZE, numBytes);
+  assert(result == 0);
+  memset(slots, 0, cntSlots*sizeof(padded_t<T>));
+  return static_cast<padded_t<T> *>(slots);
+}
+
+template<typename T>
+static inline void freePadded(padded_t<T> * const slots) {
+  free(slots);
+}
+
+//  pthread-based schedulers (D1_NUMA) number their own threads,
+//  everybody else uses the Cilk runtime's worker numbers
+static inline int * pthreadWorkerNumber() {
+  static __thread int workerNumber = 0;
+  return &workerNumber;
+}
+
+static inline void setWorkerNumber(const int workerNumber) {
+  *pthreadWorkerNumber() = workerNumber;
+}
+
+//  The number of the worker executing update(); only meaningful
+//  inside execute_rounds.
+static inline int getWorkerNumber() {
+#if D1_NUMA
+  return *pthreadWorkerNumber();
+#elif PARALLEL
+  return __cilkrts_get_worker_number();
+#else
+  return 0;
+#endif
+}
+
+//  An upper bound on getWorkerNumber() + 1
+static inline int getMaxWorkers() {
+#if D1_NUMA
+  return NUMA_WORKERS;
+#elif PARALLEL
+  return __cilkrts_get_nworkers();
+#else
+  return 1;
+#endif
+}
+
+//  Picks victims to steal from (xorshift64).  Every worker seeds its own,
+//  so that they do not all go for the same victim first.
+struct victimPicker_t {
+  uint64_t seed;
+  explicit victimPicker_t(const int self) : seed(0x9e3779b97f4a7c15ULL * (self + 1)) {}
+  //  A victim in [0, cntVictims)
+  int next(const int cntVictims) {
+    seed ^= seed << 13;
+    seed ^= seed >> 7;
+    seed ^= seed << 17;
+    return static_cast<int>(seed % cntVictims);
+  }
+};
+typedef struct victimPicker_t victimPicker_t;
+
+//  One round of a scheduler with a work queue per worker (BASELINE,
+//  D1_PRIO and D1_CHUNK).  fill(w) puts the first work into queue w; all
+//  queues are filled first, so that any worker can steal work even if the
+//  worker whose queue it is in has not started yet.  Then every worker w
+//  takes an item from take(w), or else from steal(w, &picker), until none
+//  is left.  process(w, item, stolen) does the work of an item and returns
+//  how much of the round that completed.  A worker only reports the
+//  amount to finish(cntDone) when it runs out of work, and stops once
+//  finish returns true, i.e., once the round is over.
+template<typename T, typename F, typename K, typename S, typename P, typename D>
+static inline void runWorkStealingRound(const int cntWorkers, const T none, F fill,
+                                        K take, S steal, P process, D finish) {
+  cilk_for (int w = 0; w < cntWorkers; ++w) {
+    fill(w);
+  }
+  cilk_for (int w = 0; w < cntWorkers; ++w) {
+    victimPicker_t picker(w);
+    vid_t cntDone = 0;
+    while (true) {
+      bool stolen = false;
+      T item = take(w);
+      if (item == none) {
+        item = steal(w, &picker);
+        stolen = true;
+      }
+      if (item != none) {
+        cntDone += process(w, item, stolen);
+      } else if (finish(cntDone)) {
+        break;
+      } else {
+        cntDone = 0;
+      }
+    }
+  }
+}
+
+//  Reduces [0, cntItems) in parallel.  reduceBlock(start, end) reduces
+//  a block of items serially into its own padded partial result, and the
+//  partial results are merged with combine(earlier, later) in block order,
+//  so the result does not depend on the number of workers, and is the
+//  same as a serial left-to-right reduction whenever combine is exact
+//  (e.g., for integers, bitwise operations and min/max).
+template<typename T, typename B, typename C>
+static inline T parallelReduce(const vid_t cntItems, const T identity,
+                               B reduceBlock, C combine) {
+  const vid_t cntBlocks = (cntItems + REDUCTION_BLOCK_SIZE - 1) >> REDUCTION_BLOCK_BITS;
+  if (cntBlocks == 0) {
+    return identity;
+  }
+  padded_t<T> * partials = allocatePadded<T>(cntBlocks);
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    const vid_t start = block << REDUCTION_BLOCK_BITS;
+    const vid_t end = std::min(start + REDUCTION_BLOCK_SIZE, cntItems);
+    partials[block].value = reduceBlock(start, end);
+  }
+  T total = partials[0].value;
+  for (vid_t block = 1; block < cntBlocks; block++) {
+    total = combine(total, partials[block].value);
+  }
+  freePadded(partials);
+  return total;
+}
+
+//  Sums term(i) for i in [0, cntItems) in parallel; blocks are summed
+//  serially and the block sums are added up in order.
+template<typename T, typename F>
+static inline T parallelSum(const vid_t cntItems, F term) {
+  return parallelReduce<T>(cntItems, static_cast<T>(0),
+    [&term](const vid_t start, const vid_t end) {
+      T sum = 0;
+      for (vid_t i = start; i < end; i++) {
+        sum += term(i);
+      }
+      return sum;
+    },
+    [](const T a, const T b) { return a + b; });
+}
+
+//  Returns a new[]-allocated array of the items i in [0, cntItems) for
+//  which keep(i) holds, in increasing order, and their number in
+//  outCount.  Every block counts its items, and a prefix sum over the
+//  counts tells each block where to write them.
+template<typename I, typename F>
+static inline I * parallelFilter(const I cntItems, F keep, I * const outCount) {
+  const I cntBlocks = (cntItems + REDUCTION_BLOCK_SIZE - 1) >> REDUCTION_BLOCK_BITS;
+  I * offsets = new (std::nothrow) I[cntBlocks + 1];
+  assert(offsets != NULL);
+  cilk_for (I block = 0; block < cntBlocks; block++) {
+    const I start = block << REDUCTION_BLOCK_BITS;
+    const I end = std::min(start + static_cast<I>(REDUCTION_BLOCK_SIZE), cntItems);
+    I count = 0;
+    for (I i = start; i < end; i++) {
+      if (keep(i)) {
+        count++;
+      }
+    }
+    offsets[block + 1] = count;
+  }
+  offsets[0] = 0;
+  for (I block = 0; block < cntBlocks; block++) {
+    offsets[block + 1] += offsets[block];
+  }
+
+  I * items = new (std::nothrow) I[offsets[cntBlocks]];
+  assert(items != NULL);
+  cilk_for (I block = 0; block < cntBlocks; block++) {
+    const I start = block << REDUCTION_BLOCK_BITS;
+    const I end = std::min(start + static_cast<I>(REDUCTION_BLOCK_SIZE), cntItems);
+    I position = offsets[block];
+    for (I i = start; i < end; i++) {
+      if (keep(i)) {
+        items[position++] = i;
+      }
+    }
+  }
+  *outCount = offsets[cntBlocks];
+  delete[] offsets;
+  return items;
+}
+
+//  Turns counts[0, cntItems) into their exclusive prefix sums in place,
+//  and returns the total.  Every block sums its counts, a serial scan over
+//  the block sums tells each block where it starts, and the blocks are
+//  then scanned in parallel.
+template<typename T>
+static inline T parallelPrefixSum(T * const counts, const vid_t cntItems) {
+  const vid_t cntBlocks = (cntItems + REDUCTION_BLOCK_SIZE - 1) >> REDUCTION_BLOCK_BITS;
+  T * starts = new (std::nothrow) T[cntBlocks + 1];
+  assert(starts != NULL);
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    const vid_t start = block << REDUCTION_BLOCK_BITS;
+    const vid_t end = std::min(start + REDUCTION_BLOCK_SIZE, cntItems);
+    T sum = 0;
+    for (vid_t i = start; i < end; i++) {
+      sum += counts[i];
+    }
+    starts[block + 1] = sum;
+  }
+  starts[0] = 0;
+  for (vid_t block = 0; block < cntBlocks; block++) {
+    starts[block + 1] += starts[block];
+  }
+  cilk_for (vid_t block = 0; block < cntBlocks; block++) {
+    const vid_t start = block << REDUCTION_BLOCK_BITS;
+    const vid_t end = std::min(start + REDUCTION_BLOCK_SIZE, cntItems);
+    T sum = starts[block];
+    for (vid_t i = start; i < end; i++) {
+      const T count = counts[i];
+      counts[i] = sum;
+      sum += count;
+    }
+  }
+  const T total = starts[cntBlocks];
+  delete[] starts;
+  return total;
+}
+
+//  One row of cntColumns values per worker.  Every row starts on its
+//  own cache line, so workers adding into the same column (e.g., the
+//  same round) do not share lines; a column is only summed over the
+//  workers when it is read.
+template<typename T>
+struct worker_rows_t {
+  T * values;
+  int cntRows;
+  size_t stride;
+  void init(const int cntColumns);
+  void add(const int column, const T value);  //  adds to the calling worker's row
+  T sum(const int column) const;
+};
+
+template<typename T>
+inline void worker_rows_t<T>::init(const int cntColumns) {
+  static const size_t valuesPerLine = CACHE_LINE_SIZE / sizeof(T);
+  cntRows = getMaxWorkers();
+  stride = (cntColumns + valuesPerLine - 1) / valuesPerLine * valuesPerLine;
+  void * rows = NULL;
+  int result = posix_memalign(&rows, CACHE_LINE_SIZE, cntRows*stride*sizeof(T));
+  assert(result == 0);
+  memset(rows, 0, cntRows*stride*sizeof(T));
+  values = static_cast<T *>(rows);
+}
+
+template<typename T>
+inline void worker_rows_t<T>::add(const int column, const T value) {
+  const int worker = getWorkerNumber();
+  assert(worker < cntRows);
+  values[worker*stride + column] += value;
+}
+
+template<typename T>
+inline T worker_rows_t<T>::sum(const int column) const {
+  T total = 0;
+  for (int row = 0; row < cntRows; row++) {
+    total += values[row*stride + column];
+  }
+  return total;
+}
+
+//  Per-worker sums that update() adds into while the convergence
+//  data is measured as part of the last round of a batch
+//  (see FUSED_CONVERGENCE)
+static inline padded_t<double> * fusedConvergenceSums() {
+  static padded_t<double> sums[MAX_WORKERS];
+  return sums;
+}
+
+static inline void addToFusedConvergence(const double value) {
+  const int worker = getWorkerNumber();
+  assert(worker < MAX_WORKERS);
+  fusedConvergenceSums()[worker].value += value;
+}
+
+static inline double collectFusedConvergence() {
+  double total = 0.0;
+  padded_t<double> * sums = fusedConvergenceSums();
+  for (int i = 0; i < MAX_WORKERS; i++) {
+    total += sums[i].value;
+    sums[i].value = 0.0;
+  }
+  return total;
+}
+
+#endif  // REDUCTION_H_
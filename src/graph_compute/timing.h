@@ -0,0 +1,51 @@
+#ifndef TIMING_H_
+#define TIMING_H_
+
+#include <x86intrin.h>
+#include <cstdint>
+#include <ctime>
+#include <cassert>
+
+static inline struct timespec monotonicNow() {
+  struct timespec now;
+  int result = clock_gettime(CLOCK_MONOTONIC, &now);
+  assert(result == 0);
+  return now;
+}
+
+static inline double secondsBetween(const struct timespec& starttime,
+                                    const struct timespec& endtime) {
+  int64_t ns = endtime.tv_nsec;
+  ns -= starttime.tv_nsec;
+  double seconds = static_cast<double>(ns) * 1e-9;
+  seconds += endtime.tv_sec - starttime.tv_sec;
+  return seconds;
+}
+
+//  The time stamp counter; cheap enough to read around every spin loop
+static inline uint64_t readCycleCounter() {
+  return __rdtsc();
+}
+
+//  Returns the seconds elapsed since *lapStart, and starts the next lap
+static inline double lapSeconds(struct timespec * const lapStart) {
+  const struct timespec now = monotonicNow();
+  const double seconds = secondsBetween(*lapStart, now);
+  *lapStart = now;
+  return seconds;
+}
+
+//  Wall-clock seconds spent in each phase of prepareTestRun
+struct startupTimes_t {
+  double load;              //  reading the edge file and counting edges
+  double checkGraph;        //  TEST_SIMPLE_AND_UNDIRECTED only
+  double initScheduling;
+  double fillInNodeData;    //  zero when restored from a checkpoint
+  double fillInGlobalData;  //  zero when restored from a checkpoint
+  double total() const {
+    return load + checkGraph + initScheduling + fillInNodeData + fillInGlobalData;
+  }
+};
+typedef struct startupTimes_t startupTimes_t;
+
+#endif  // TIMING_H_
@@ -0,0 +1,192 @@
+#include "./topology.h"
+#include <unistd.h>
+#include <pthread.h>
+#include <sched.h>
+#include <cstdio>
+#include <string>
+#include <tuple>
+#include <vector>
+#include <map>
+#include <algorithm>
+
+using namespace std;
+
+//  Calls visit on every CPU of a list like 0-3,8-11 in the file at path.
+//  Returns false if the file cannot be read.
+template<typename V>
+static bool readCpuList(const string& path, V visit) {
+  FILE * file = fopen(path.c_str(), "r");
+  if (file == NULL) {
+    return false;
+  }
+  int first;
+  while (fscanf(file, "%d", &first) == 1) {
+    int last = first;
+    int separator = fgetc(file);
+    if ((separator == '-') && (fscanf(file, "%d", &last) == 1)) {
+      separator = fgetc(file);
+    }
+    for (int cpu = first; cpu <= last; cpu++) {
+      visit(cpu);
+    }
+    if (separator != ',') {
+      break;
+    }
+  }
+  fclose(file);
+  return true;
+}
+
+//  The lowest CPU of the list at path, or -1
+static int lowestCpu(const string& path) {
+  int lowest = -1;
+  readCpuList(path, [&lowest](const int cpu) {
+    if ((lowest < 0) || (cpu < lowest)) {
+      lowest = cpu;
+    }
+  });
+  return lowest;
+}
+
+//  The number in the file at path, or -1
+static int readNumber(const string& path) {
+  FILE * file = fopen(path.c_str(), "r");
+  if (file == NULL) {
+    return -1;
+  }
+  int value;
+  if (fscanf(file, "%d", &value) != 1) {
+    value = -1;
+  }
+  fclose(file);
+  return value;
+}
+
+void readTopology(const int cntCpus, cpuPlace_t * const places) {
+  for (int cpu = 0; cpu < cntCpus; cpu++) {
+    const string root = "/sys/devices/system/cpu/cpu" + to_string(cpu);
+    places[cpu].core = lowestCpu(root + "/topology/thread_siblings_list");
+    //  the cache with the highest level is the last-level cache
+    places[cpu].llc = -1;
+    int llcLevel = 0;
+    for (int index = 0; ; index++) {
+      const string cache = root + "/cache/index" + to_string(index);
+      const int level = readNumber(cache + "/level");
+      if (level < 0) {
+        break;
+      }
+      if (level > llcLevel) {
+        llcLevel = level;
+        places[cpu].llc = lowestCpu(cache + "/shared_cpu_list");
+      }
+    }
+    //  the socket, unless there are NUMA nodes below
+    places[cpu].node = lowestCpu(root + "/topology/core_siblings_list");
+  }
+
+  const string nodeRoot = "/sys/devices/system/node/node";
+  readCpuList("/sys/devices/system/node/online", [cntCpus, places, &nodeRoot](
+      const int node) {
+    const string cpuList = nodeRoot + to_string(node) + "/cpulist";
+    const int lowest = lowestCpu(cpuList);
+    readCpuList(cpuList, [cntCpus, places, lowest](const int cpu) {
+      if (cpu < cntCpus) {
+        places[cpu].node = lowest;
+      }
+    });
+  });
+}
+
+stealLevel_t stealLevel(const cpuPlace_t& thief, const cpuPlace_t& victim) {
+  if ((thief.core >= 0) && (thief.core == victim.core)) {
+    return STEAL_SMT;
+  } else if ((thief.llc >= 0) && (thief.llc == victim.llc)) {
+    return STEAL_LLC;
+  } else if ((thief.node >= 0) && (thief.node == victim.node)) {
+    return STEAL_NODE;
+  } else {
+    return STEAL_REMOTE;
+  }
+}
+
+//  The CPUs the process may run on, in the order of PIN_POLICY, and
+//  where every CPU up to the highest of them sits
+struct pinning_t {
+  vector<int> cpus;
+  vector<cpuPlace_t> places;
+  pinning_t();
+};
+typedef struct pinning_t pinning_t;
+
+pinning_t::pinning_t() {
+  cpu_set_t allowed;
+  CPU_ZERO(&allowed);
+  if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0) {
+    const int cntOnline = sysconf(_SC_NPROCESSORS_ONLN);
+    for (int cpu = 0; (cpu < cntOnline) && (cpu < CPU_SETSIZE); cpu++) {
+      CPU_SET(cpu, &allowed);
+    }
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (CPU_ISSET(cpu, &allowed)) {
+      cpus.push_back(cpu);
+    }
+  }
+  places.resize(cpus.back() + 1);
+  readTopology(places.size(), places.data());
+
+  //  compact: SMT siblings next to each other, then the rest of their
+  //  last-level cache, then the rest of their node
+  const vector<cpuPlace_t>& place = places;
+  std::sort(cpus.begin(), cpus.end(), [&place](const int a, const int b) {
+    return std::tie(place[a].node, place[a].llc, place[a].core, a)
+      < std::tie(place[b].node, place[b].llc, place[b].core, b);
+  });
+#if PIN_POLICY != PIN_COMPACT
+  //  rank the hardware threads of every core, and order by that rank
+  vector<int> rank(places.size(), 0);
+  for (size_t i = 1; i < cpus.size(); i++) {
+    if ((place[cpus[i]].core >= 0) && (place[cpus[i]].core == place[cpus[i - 1]].core)) {
+      rank[cpus[i]] = rank[cpus[i - 1]] + 1;
+    }
+  }
+  std::stable_sort(cpus.begin(), cpus.end(), [&rank](const int a, const int b) {
+    return rank[a] < rank[b];
+  });
+#endif
+#if PIN_POLICY == PIN_SCATTER
+  //  then deal the CPUs of every node round-robin over the nodes
+  std::map<int, int> cntInNode;
+  for (size_t i = 0; i < cpus.size(); i++) {
+    rank[cpus[i]] = cntInNode[place[cpus[i]].node]++;
+  }
+  std::stable_sort(cpus.begin(), cpus.end(), [&rank](const int a, const int b) {
+    return rank[a] < rank[b];
+  });
+#endif
+}
+
+//  built on first use, before any worker thread pins itself, so that it
+//  sees the affinity mask of the whole process
+static const pinning_t& pinning() {
+  static const pinning_t pinning;
+  return pinning;
+}
+
+int workerCpu(const int worker) {
+  const vector<int>& cpus = pinning().cpus;
+  return cpus[worker % cpus.size()];
+}
+
+const cpuPlace_t& workerPlace(const int worker) {
+  return pinning().places[workerCpu(worker)];
+}
+
+//  http://stackoverflow.com/questions
+//  /1407786/how-to-set-cpu-affinity-of-a-particular-pthread
+int bindThreadToWorkerCpu(const int worker) {
+  cpu_set_t cpuset;
+  CPU_ZERO(&cpuset);
+  CPU_SET(workerCpu(worker), &cpuset);
+  return pthread_setaffinity_np(pthread_self(), sizeof(cpu_set_t), &cpuset);
+}
@@ -0,0 +1,64 @@
+#ifndef TOPOLOGY_H_
+#define TOPOLOGY_H_
+
+//  how workers are pinned to the CPUs the process may run on
+//  (sched_getaffinity, so taskset and cgroup cpusets are honored):
+//  0 (compact) fills an SMT core, then its last-level cache, then its
+//  NUMA node before moving on, 1 (scatter) deals the workers round-robin
+//  over the NUMA nodes, and 2 (cores first, the default) uses one hardware
+//  thread of every core before any SMT sibling.  Worker i is the i-th CPU
+//  of that order; with more workers than CPUs, the order wraps around.
+#ifndef PIN_POLICY
+  #define PIN_POLICY 2
+#endif
+
+//  the values of PIN_POLICY
+#define PIN_COMPACT 0
+#define PIN_SCATTER 1
+#define PIN_CORES_FIRST 2
+
+#if PIN_POLICY == PIN_COMPACT
+  #define PIN_POLICY_NAME "compact"
+#elif PIN_POLICY == PIN_SCATTER
+  #define PIN_POLICY_NAME "scatter"
+#elif PIN_POLICY == PIN_CORES_FIRST
+  #define PIN_POLICY_NAME "cores first"
+#else
+  #error "PIN_POLICY needs to be 0 (compact), 1 (scatter) or 2 (cores first)"
+#endif
+
+//  Where a logical CPU sits in the machine.  Every field names the group
+//  of CPUs sharing that resource by its lowest-numbered CPU, or is -1 if
+//  the kernel does not say.
+struct cpuPlace_t {
+  int core;  //  the SMT siblings of one physical core
+  int llc;  //  the CPUs sharing the last-level cache
+  int node;  //  the CPUs of one NUMA node (or socket, without NUMA nodes)
+};
+typedef struct cpuPlace_t cpuPlace_t;
+
+//  How far away a victim is from a thief, nearest first
+enum stealLevel_t {
+  STEAL_SMT = 0,  //  another hardware thread of the same core
+  STEAL_LLC = 1,  //  a core sharing the last-level cache
+  STEAL_NODE = 2,  //  a core of the same NUMA node
+  STEAL_REMOTE = 3  //  anybody else
+};
+
+static const int CNT_STEAL_LEVELS = 4;
+
+//  Fills in places[0 .. cntCpus-1] from /sys/devices/system/cpu and
+//  /sys/devices/system/node
+void readTopology(const int cntCpus, cpuPlace_t * const places);
+
+//  The nearest level whose group contains both CPUs
+stealLevel_t stealLevel(const cpuPlace_t& thief, const cpuPlace_t& victim);
+
+//  The CPU that worker runs on under PIN_POLICY, and where it sits
+int workerCpu(const int worker);
+const cpuPlace_t& workerPlace(const int worker);
+
+//  Pins the calling thread to workerCpu(worker); returns 0 or an errno value
+int bindThreadToWorkerCpu(const int worker);
+
+#endif  // TOPOLOGY_H_